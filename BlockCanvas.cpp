@@ -0,0 +1,265 @@
+//
+//  BlockCanvas.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "BlockCanvas.hpp"
+
+using namespace juce;
+
+static int edgeIndex(Block::ConnectionPort::DeviceEdge edge) {
+    switch (edge) {
+        case juce::Block::ConnectionPort::DeviceEdge::north:
+            return 0;
+        case juce::Block::ConnectionPort::DeviceEdge::east:
+            return 1;
+        case juce::Block::ConnectionPort::DeviceEdge::south:
+            return 2;
+        case juce::Block::ConnectionPort::DeviceEdge::west:
+            return 3;
+        default:
+            break;
+    }
+    return 0;
+}
+
+static int rotationSteps(int degrees) {
+    return ((degrees / 90) % 4 + 4) % 4;
+}
+
+BlockCanvas::BlockCanvas() : frame(0, 0) {
+    active = false;
+}
+
+BlockCanvas::~BlockCanvas() {
+    detach();
+}
+
+void BlockCanvas::layout(const BlockTopology& topology, const OwnedArray<BlockComponent>& components) {
+    detach();
+
+    // the master block is the origin of the canvas
+    Array<BlockComponent*> pads;
+    for (BlockComponent* component : components) {
+        // emulated pads have no position in the topology
+        if (component->block==nullptr) continue;
+        if (component->block->getType()==Block::lightPadBlock) {
+            if (component->block->isMasterBlock()) {
+                pads.insert(0, component);
+            } else {
+                pads.add(component);
+            }
+        }
+    }
+
+    // every group of connected blocks is placed right of the previous one
+    int nextColumn = 0;
+    int numRows = 0;
+    for (BlockComponent* pad : pads) {
+        if (indexOfComponent(pad)>=0) continue;
+
+        int firstTile = tiles.size();
+        tiles.add({pad, 0, 0, rotationSteps(pad->block->getRotation())});
+        addConnectedTiles(firstTile, topology, pads);
+
+        int minColumn = 0, maxColumn = 0, minRow = 0, maxRow = 0;
+        for (int i = firstTile; i < tiles.size(); i++) {
+            minColumn = jmin(minColumn, tiles.getReference(i).column);
+            maxColumn = jmax(maxColumn, tiles.getReference(i).column);
+            minRow = jmin(minRow, tiles.getReference(i).row);
+            maxRow = jmax(maxRow, tiles.getReference(i).row);
+        }
+        for (int i = firstTile; i < tiles.size(); i++) {
+            tiles.getReference(i).column += nextColumn - minColumn;
+            tiles.getReference(i).row -= minRow;
+        }
+        nextColumn += maxColumn - minColumn + 1;
+        numRows = jmax(numRows, maxRow - minRow + 1);
+    }
+
+    frame = LedFrame(nextColumn * 15, numRows * 15);
+    for (auto& tile : tiles) {
+        tile.component->canvas = this;
+    }
+    active = true;
+}
+
+void BlockCanvas::addConnectedTiles(int firstTile, const BlockTopology& topology, const Array<BlockComponent*>& pads) {
+    // breadth first, tiles added in the loop are visited as well
+    for (int i = firstTile; i < tiles.size(); i++) {
+        Tile tile = tiles.getReference(i);
+        Block::UID uid = tile.component->block->uid;
+
+        for (auto& connection : topology.connections) {
+            bool isFirst = connection.device1==uid;
+            if (!isFirst && connection.device2!=uid) continue;
+
+            Block::UID otherUid = isFirst ? connection.device2 : connection.device1;
+            Block::ConnectionPort port = isFirst ? connection.connectionPortOnDevice1 : connection.connectionPortOnDevice2;
+            Block::ConnectionPort otherPort = isFirst ? connection.connectionPortOnDevice2 : connection.connectionPortOnDevice1;
+
+            BlockComponent *other = nullptr;
+            for (BlockComponent* pad : pads) {
+                if (pad->block->uid==otherUid) {
+                    other = pad;
+                    break;
+                }
+            }
+            if (other==nullptr || indexOfComponent(other)>=0) continue;
+
+            // direction of the edge on the canvas
+            int direction = (edgeIndex(port.edge) + tile.rotation) % 4;
+            int column = tile.column + (direction==1 ? 1 : 0) - (direction==3 ? 1 : 0);
+            int row = tile.row + (direction==2 ? 1 : 0) - (direction==0 ? 1 : 0);
+
+            bool occupied = false;
+            for (int j = firstTile; j < tiles.size(); j++) {
+                if (tiles.getReference(j).column==column && tiles.getReference(j).row==row) {
+                    occupied = true;
+                    break;
+                }
+            }
+            if (occupied) continue;
+
+            // the edge of the other block is facing back to this one
+            int rotation = (direction + 2 - edgeIndex(otherPort.edge) + 4) % 4;
+            tiles.add({other, column, row, rotation});
+        }
+    }
+}
+
+void BlockCanvas::detach() {
+    for (auto& tile : tiles) {
+        tile.component->canvas = nullptr;
+    }
+    tiles.clear();
+    frame = LedFrame(0, 0);
+    active = false;
+}
+
+void BlockCanvas::removeComponent(BlockComponent* component) {
+    int index = indexOfComponent(component);
+    if (index>=0) {
+        tiles.remove(index);
+    }
+    component->canvas = nullptr;
+}
+
+Array<BlockComponent*> BlockCanvas::getComponents() const {
+    Array<BlockComponent*> components;
+    for (auto& tile : tiles) {
+        components.add(tile.component);
+    }
+    return components;
+}
+
+int BlockCanvas::indexOfComponent(const BlockComponent* component) const {
+    for (int i = 0; i < tiles.size(); i++) {
+        if (tiles.getReference(i).component==component) return i;
+    }
+    return -1;
+}
+
+void BlockCanvas::toCanvas(const Tile& tile, float x, float y, float size, float& canvasX, float& canvasY) const {
+    float rx = x;
+    float ry = y;
+    if (tile.rotation==1) {
+        rx = size - y;
+        ry = x;
+    } else if (tile.rotation==2) {
+        rx = size - x;
+        ry = size - y;
+    } else if (tile.rotation==3) {
+        rx = y;
+        ry = size - x;
+    }
+    canvasX = tile.column * 15 + rx;
+    canvasY = tile.row * 15 + ry;
+}
+
+void BlockCanvas::setLEDColor(int x, int y, uint32 colour) {
+    frame.setPixel(x, y, colour);
+}
+
+void BlockCanvas::setRectColor(int x, int y, int w, int h, uint32 colour) {
+    frame.fillRect(x, y, w, h, colour);
+}
+
+void BlockCanvas::setCircleColor(int x, int y, int r, uint32 colour) {
+    frame.drawCircle(x, y, r, colour);
+}
+
+void BlockCanvas::clearScreen() {
+    frame.clear();
+}
+
+void BlockCanvas::uploadFrame() {
+    Array<Array<LightpadCommand>> commands;
+    int numCommands = 0;
+    for (auto& tile : tiles) {
+        LedFrame blockFrame;
+        for (int y = 0; y < 15; ++y) {
+            for (int x = 0; x < 15; ++x) {
+                float canvasX, canvasY;
+                toCanvas(tile, (float)x, (float)y, 14, canvasX, canvasY);
+                blockFrame.setPixel(x, y, frame.getPixel((int)canvasX, (int)canvasY));
+            }
+        }
+        Array<LightpadCommand> blockCommands;
+        tile.component->addFrameCommands(blockFrame, blockCommands);
+        numCommands = jmax(numCommands, blockCommands.size());
+        commands.add(blockCommands);
+    }
+
+    // interleave the blocks, so they are all updated at the same time
+    for (int i = 0; i < numCommands; i++) {
+        for (int t = 0; t < tiles.size(); t++) {
+            const Array<LightpadCommand>& blockCommands = commands.getReference(t);
+            if (i<blockCommands.size()) {
+                tiles.getReference(t).component->sendCommand(blockCommands.getReference(i), true);
+            }
+        }
+    }
+}
+
+void BlockCanvas::touchChanged(BlockComponent& component, const TouchSurface::Touch& t) {
+    int index = indexOfComponent(&component);
+    if (index<0) return;
+
+    // touch positions are 0 - 2 on a Lightpad, convert them to leds
+    float x, y;
+    toCanvas(tiles.getReference(index), t.x * 7.5f, t.y * 7.5f, 15, x, y);
+
+    float phase = 2;
+    if (t.isTouchStart) phase = 1;
+    else if (t.isTouchEnd) phase = 0;
+
+    // 24 touches per block, so the index is unique on the canvas
+    t_atom at[6];
+    SETSYMBOL(at, gensym("touch"));
+    SETFLOAT(at + 1, (t_float)static_cast<float>(index * 24 + t.index));
+    SETFLOAT(at + 2, (t_float)phase);
+    SETFLOAT(at + 3, (t_float)x);
+    SETFLOAT(at + 4, (t_float)y);
+    SETFLOAT(at + 5, (t_float)t.z);
+    outlet_anything(component.out_action, gensym("canvas"), 6, at);
+}
+
+void BlockCanvas::outputLayout(t_outlet *out) {
+    t_symbol *name = gensym("canvas");
+    t_atom at[5];
+    SETSYMBOL(at, gensym("size"));
+    SETFLOAT(at + 1, (t_float)static_cast<float>(getWidth()));
+    SETFLOAT(at + 2, (t_float)static_cast<float>(getHeight()));
+    outlet_anything(out, name, 3, at);
+
+    for (auto& tile : tiles) {
+        SETSYMBOL(at, gensym(tile.component->pdName->toStdString().c_str()));
+        SETFLOAT(at + 1, (t_float)static_cast<float>(tile.column * 15 + 1));
+        SETFLOAT(at + 2, (t_float)static_cast<float>(tile.row * 15 + 1));
+        SETFLOAT(at + 3, (t_float)static_cast<float>(tile.rotation * 90));
+        outlet_anything(out, name, 4, at);
+    }
+}
@@ -0,0 +1,72 @@
+//
+//  BlockCanvas.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+#include "BlockComponent.hpp"
+#include "LedFrame.hpp"
+#include "m_pd.h"
+
+// One big drawing surface made of all connected Lightpads. The blocks are
+// laid out with the connections of the topology and their rotation, drawing
+// happens in canvas coordinates and 'frame' uploads the differences to every
+// block.
+class BlockCanvas
+{
+public:
+    BlockCanvas();
+    ~BlockCanvas();
+
+    bool isActive() const { return active; }
+
+    // lay out the Lightpads of the topology and add them to the canvas
+    void layout(const juce::BlockTopology& topology, const juce::OwnedArray<BlockComponent>& components);
+    // remove all blocks from the canvas
+    void detach();
+    // called by a component, which is about to be deleted
+    void removeComponent(BlockComponent* component);
+
+    juce::Array<BlockComponent*> getComponents() const;
+
+    int getWidth() const { return frame.getWidth(); }
+    int getHeight() const { return frame.getHeight(); }
+
+    // drawing in canvas coordinates (starting at 0)
+    void setLEDColor(int x, int y, juce::uint32 colour);
+    void setRectColor(int x, int y, int w, int h, juce::uint32 colour);
+    void setCircleColor(int x, int y, int r, juce::uint32 colour);
+    void clearScreen();
+
+    // split the canvas into the blocks and send the changed leds
+    void uploadFrame();
+
+    // touches of the blocks in canvas coordinates
+    void touchChanged(BlockComponent& component, const juce::TouchSurface::Touch& t);
+
+    // output size and position of the blocks
+    void outputLayout(t_outlet *out);
+
+private:
+    struct Tile
+    {
+        BlockComponent *component;
+        int column;
+        int row;
+        int rotation; // in 90 degree steps clockwise
+    };
+
+    juce::Array<Tile> tiles;
+    LedFrame frame;
+    bool active;
+
+    int indexOfComponent(const BlockComponent* component) const;
+    void addConnectedTiles(int firstTile, const juce::BlockTopology& topology, const juce::Array<BlockComponent*>& pads);
+    void toCanvas(const Tile& tile, float x, float y, float size, float& canvasX, float& canvasY) const;
+
+    JUCE_LEAK_DETECTOR (BlockCanvas)
+};
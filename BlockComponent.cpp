@@ -7,21 +7,58 @@
 //
 
 #include "BlockComponent.hpp"
+#include "BlockCanvas.hpp"
+#include "FrameEncoder.hpp"
+#include "Tracer.hpp"
+#include <cstring>
 
 using namespace juce;
 
+// drawing commands, which are acknowledged in the order they were sent
+static bool isDrawingCommand(uint32 command) {
+    return (command>=4 && command<=8) || (command>=13 && command<=15);
+}
+
+// leds, packed leds and runs, which the block doesn't echo with verified drawing
+static bool isBulkCommand(uint32 command) {
+    return command==4 || command==14 || command==15;
+}
+
+// heap target, which a message overwrites completely (or -1): a later message
+// of the same slot replaces the earlier one. The retained state keeps the
+// settings of the program, the leds are kept as a frame. The queues also
+// replace a waiting led or palette leds, but not a waiting color mode, double
+// buffering or verified drawing, which change the drawing after them
+static int messageSlot(const LightpadCommand& message, bool queued) {
+    uint32 command = message.commandNr;
+    uint32 subCommand = message.subCommandNr;
+    int slot = (int)((command << 16) + (subCommand << 8));
+    // mode, grid size, object colours and 3 palette colors
+    if (command<=2 || (command==13 && subCommand>0)) return slot;
+    // faders, mixer buttons and mixer faders
+    if (command==3) return slot + (int)(message.param2 & 0xff);
+    // number overlay, shown or hidden
+    if (command==9) return (int)(command << 16);
+    if (queued) {
+        // a led or 18 palette leds
+        if (command==4 || command==14) return slot;
+    } else {
+        // color mode, double buffering (not the swaps) and verified drawing
+        if ((command==12 || command==13 || command==16) && subCommand==0) return slot;
+    }
+    return -1;
+}
+
+static bool isSameCommand(const LightpadCommand& a, const LightpadCommand& b) {
+    return a.commandNr==b.commandNr && a.subCommandNr==b.subCommandNr && a.param1==b.param1 && a.param2==b.param2 && a.param3==b.param3;
+}
+
 BlockComponent::BlockComponent(Block::Ptr blockToUse, bool loadProgram) {
     
     block = blockToUse;
+    link = nullptr;
     pdName = new String(block->getDeviceDescription().upToFirstOccurrenceOf(String(" "), false, false).toLowerCase());
-
-    blockMode = mLogo;
-    gridSize = 0;
-    
-    messageSet = new NamedValueSet();
-    rwLock = new ReadWriteLock();
-    startTimer(50);
-    
+    initialise();
     
     // Register BlockComponent as a listener to the touch surface
     if (auto touchSurface = block->getTouchSurface()) {
@@ -38,11 +75,61 @@ BlockComponent::BlockComponent(Block::Ptr blockToUse, bool loadProgram) {
         block->setProgram (new LightpadProgram (*block));
     }
     
+    readConfigMetaData();
+}
+
+BlockComponent::BlockComponent(LightpadLink *linkToUse, String name) {
+    link = linkToUse;
+    pdName = new String(name);
+    initialise();
+}
+
+void BlockComponent::initialise() {
+    blockMode = mLogo;
+    gridSize = 0;
+    canvas = nullptr;
+    listener = nullptr;
+    doubleBuffered = false;
+    displayBuffer = 0;
+    swapPending = false;
+    commitTime = 0;
+    swapTime = 0;
+    indexedColor = false;
+    palette.insertMultiple(0, 0, 16);
+    recorder = nullptr;
+    internalSend = false;
+    dropStaleFrames = false;
+    frameNumber = 0;
+    quietDrawing = false;
+    dirtyRows = 0;
+    for (uint32& checksum : expectedChecksums) {
+        checksum = 0;
+    }
+    for (float& info : lastInfos) {
+        info = -1;
+    }
+    
+    messageSet = new NamedValueSet();
+    rwLock = new ReadWriteLock();
+    lastResendCheck = 0;
+    lastDecreaseTime = 0;
+    rateLimited = false;
+    linkHealth = healthyLink;
+    lastAckTime = Time::getMillisecondCounterHiRes();
+    lastCongestionTime = 0;
+    lastProbeTime = 0;
+    setMaxRate(-1);
+    startTimer(10);
 }
 
 BlockComponent::~BlockComponent() {
+    if (canvas!=nullptr) {
+        canvas->removeComponent(this);
+    }
+    stopRecording();
     rwLock->~ReadWriteLock();
     rwLock = nullptr;
+    if (block==nullptr) return;
     // Remove any listeners
     if (auto touchSurface = block->getTouchSurface()) {
         block->removeProgramEventListener(this);
@@ -53,7 +140,12 @@ BlockComponent::~BlockComponent() {
 }
 
 void BlockComponent::setDefault() {
-    block->saveProgramAsDefault();
+    if (block!=nullptr) block->saveProgramAsDefault();
+}
+
+bool BlockComponent::hasLightpadProgram() {
+    if (block==nullptr) return link!=nullptr;
+    return dynamic_cast<LightpadProgram*> (block->getProgram())!=nullptr;
 }
 
 void BlockComponent::setLightpadMode(String name) {
@@ -79,7 +171,7 @@ void BlockComponent::setGridSize(int size) {
 }
 
 void BlockComponent::setColors(juce::OwnedArray<juce::LEDColour>* colors) {
-    if (auto program = dynamic_cast<LightpadProgram*> (block->getProgram())) {
+    if (hasLightpadProgram()) {
         int c = 0;
 
         for (int i = 0; i<8; i++) {
@@ -106,25 +198,29 @@ void BlockComponent::setColors(juce::OwnedArray<juce::LEDColour>* colors) {
 }
 
 void BlockComponent::setLEDColor(int x, int y, LEDColour *colour) {
-    int c = colour->getARGB();
+    int c = deviceColor(colour->getARGB());
     int ledNr = x + y * 15;
+    ledFrame.drawLED(ledNr, c);
     sendStampedMessage(4, ledNr, 0, 0, c);
 }
 
 void BlockComponent::setRectColor(int x, int y, int w, int h, LEDColour *colour) {
-    int c = colour->getARGB();
+    int c = deviceColor(colour->getARGB());
     int ledNr = x + y * 15;
+    ledFrame.drawRect(ledNr, w, h, c);
     sendStampedMessage(6, ledNr, w, h, c);
 }
 
 void BlockComponent::setCircleColor(int x, int y, int r, LEDColour *colour) {
-    int c = colour->getARGB();
+    int c = deviceColor(colour->getARGB());
+    ledFrame.drawCircle(x, y, r, c);
     sendStampedMessage(7, x, y, r, c);
 }
 
 void BlockComponent::setTriangleColor(int x, int y, int s, int deg, juce::LEDColour *colour) {
-    int c = colour->getARGB();
+    int c = deviceColor(colour->getARGB());
     int param2 = (s << 16) + (deg & 0xffff);
+    ledFrame.drawTriangle(x, y, s, deg, c);
     sendStampedMessage(8, x, y, param2, c);
 }
 
@@ -138,9 +234,335 @@ void BlockComponent::hideNumberColor() {
 }
 
 void BlockComponent::clearScreen() {
+    ledFrame.clear();
     sendStampedMessage(5, 0, 0, 0, 0);
 }
 
+void BlockComponent::setColorMode(bool indexed) {
+    // the block clears the leds and the palette only for a new mode
+    if (indexed==indexedColor) return;
+    indexedColor = indexed;
+    ledFrame.setIndexed(indexed);
+    palette.fill(0);
+    sendStampedMessage(13, 0, 0, 0, indexed ? 1 : 0);
+}
+
+void BlockComponent::setPalette(juce::OwnedArray<juce::LEDColour>* colors) {
+    for (int i = 0; i < 16; i++) {
+        palette.set(i, colors->operator[](i % colors->size())->getARGB() & 0x00ffffff);
+    }
+    // 3 colors per message, same as for the pads
+    for (int i = 0; i < 16; i += 3) {
+        uint32 color1 = palette[i];
+        uint32 color2 = palette[jmin(i + 1, 15)];
+        uint32 color3 = palette[jmin(i + 2, 15)];
+        
+        uint8 param1 = (color1 & 0x00ff0000) >> 16;
+        uint32 param2 = ((color1 & 0x0000ffff) << 16) + ((color2 & 0x00ffff00) >> 8);
+        uint32 param3 = ((color2 & 0x000000ff) << 24) + (color3 & 0x00ffffff);
+        
+        sendStampedMessage(13, i + 1, param1, param2, param3);
+    }
+}
+
+void BlockComponent::setPixels(int ledNr, const Array<int>& indexes) {
+    for (int i = 0; i < indexes.size(); i++) {
+        ledFrame.drawLED(ledNr + i, (uint32)indexes[i]);
+    }
+    for (int i = 0; i < indexes.size(); i += 18) {
+        if (ledNr + i >= 0 && ledNr + i < 225) {
+            sendCommand(FrameEncoder::packPixels(ledFrame, ledNr + i));
+        }
+    }
+}
+
+int BlockComponent::nearestPaletteIndex(uint32 colour) {
+    int nearest = 0;
+    int minDistance = -1;
+    for (int i = 0; i < 16; i++) {
+        int red = (int)((colour >> 16) & 0xff) - (int)((palette[i] >> 16) & 0xff);
+        int green = (int)((colour >> 8) & 0xff) - (int)((palette[i] >> 8) & 0xff);
+        int blue = (int)(colour & 0xff) - (int)(palette[i] & 0xff);
+        int distance = red*red + green*green + blue*blue;
+        if (minDistance<0 || distance<minDistance) {
+            minDistance = distance;
+            nearest = i;
+        }
+    }
+    return nearest;
+}
+
+uint32 BlockComponent::deviceColor(uint32 argb) {
+    if (indexedColor) {
+        return (uint32)nearestPaletteIndex(argb);
+    }
+    return argb;
+}
+
+void BlockComponent::uploadFrame(const LedFrame& frame) {
+    // the whole frame before the checksums
+    const MessageManagerLock mmLock;
+    Array<LightpadCommand> commands;
+    addFrameCommands(frame, commands);
+    for (auto& command : commands) {
+        sendCommand(command, true);
+    }
+}
+
+void BlockComponent::addFrameCommands(const LedFrame& frame, Array<LightpadCommand>& commands) {
+    LedFrame target;
+    target.setIndexed(indexedColor);
+    for (int i = 0; i < 225; i++) {
+        uint32 colour = frame.getLED(i);
+        target.drawLED(i, indexedColor ? (uint32)nearestPaletteIndex(colour) : colour);
+    }
+    const MessageManagerLock mmLock;
+    BlockStats::add(stats.framesSubmitted);
+    frameNumber++;
+    if (dropStaleFrames) dropQueuedFrames();
+    FrameEncoder::encode(ledFrame, target, commands);
+    ledFrame = target;
+}
+
+void BlockComponent::dropQueuedFrames() {
+    // the older frames, which are still waiting (or partly sent)
+    Array<QueuedMessage>& drawing = lanes[drawingLane];
+    Array<int> droppedFrames;
+    for (int i = drawing.size(); --i >= 0;) {
+        int frame = drawing.getReference(i).frame;
+        if (frame==0) continue;
+        droppedFrames.addIfNotAlreadyThere(frame);
+        drawing.remove(i);
+        stats.laneQueued[drawingLane].fetch_sub(1, std::memory_order_relaxed);
+    }
+    BlockStats::add(stats.framesDropped, droppedFrames.size());
+    
+    // the leds on the block, after the other drawing is sent
+    ledFrame = sentFrame;
+    for (auto& queued : drawing) {
+        FrameEncoder::apply(queued.command, ledFrame);
+    }
+}
+
+BlockComponent::RetainedState BlockComponent::retainState() {
+    const MessageManagerLock mmLock;
+    RetainedState state;
+    state.blockMode = blockMode;
+    state.gridSize = gridSize;
+    state.indexedColor = indexedColor;
+    state.palette = palette;
+    state.doubleBuffered = doubleBuffered;
+    state.dropStaleFrames = dropStaleFrames;
+    state.ledFrame = ledFrame;
+    // in the order of the slots: mode, colours, faders, overlay, buffering, color mode and palette
+    Array<int> slots;
+    for (HashMap<int, LightpadCommand>::Iterator i(stateCommands); i.next();) {
+        slots.add(i.getKey());
+    }
+    slots.sort();
+    for (int slot : slots) {
+        state.commands.add(stateCommands[slot]);
+    }
+    return state;
+}
+
+void BlockComponent::restoreState(const RetainedState& state) {
+    if (!hasLightpadProgram()) return;
+    const MessageManagerLock mmLock;
+    blockMode = state.blockMode;
+    gridSize = state.gridSize;
+    indexedColor = state.indexedColor;
+    palette = state.palette;
+    doubleBuffered = state.doubleBuffered;
+    dropStaleFrames = state.dropStaleFrames;
+    for (auto& command : state.commands) {
+        sendCommand(command);
+    }
+    // the leds are cleared by the program and by the color mode
+    ledFrame.clear();
+    ledFrame.setIndexed(indexedColor);
+    Array<LightpadCommand> commands;
+    FrameEncoder::encode(ledFrame, state.ledFrame, commands);
+    for (auto& command : commands) {
+        sendCommand(command);
+    }
+    ledFrame = state.ledFrame;
+    // the drawing went to the hidden buffer
+    if (doubleBuffered) swapBuffers();
+}
+
+void BlockComponent::storeScene(int number) {
+    Scene scene = {number, retainState()};
+    for (auto& stored : scenes) {
+        if (stored.number==number) {
+            stored = scene;
+            return;
+        }
+    }
+    scenes.add(scene);
+}
+
+bool BlockComponent::recallScene(int number) {
+    const MessageManagerLock mmLock;
+    const Scene *scene = nullptr;
+    for (auto& stored : scenes) {
+        if (stored.number==number) scene = &stored;
+    }
+    if (scene==nullptr) return false;
+    const RetainedState& state = scene->state;
+    
+    // a new color mode clears the leds and the palette first
+    if (state.indexedColor!=indexedColor) setColorMode(state.indexedColor);
+    // the overlay and the double buffering of a scene without them
+    Array<int> slots;
+    for (auto& command : state.commands) {
+        slots.add(messageSlot(command, false));
+    }
+    if (!slots.contains(9 << 16) && stateCommands.contains(9 << 16) && stateCommands[9 << 16].subCommandNr!=0) hideNumberColor();
+    if (!slots.contains(12 << 16) && doubleBuffered) setDoubleBuffering(false);
+    
+    // only the mode, colours, faders etc. which changed
+    for (auto& command : state.commands) {
+        if (command.commandNr==16) continue;
+        int slot = messageSlot(command, false);
+        if (stateCommands.contains(slot) && isSameCommand(stateCommands[slot], command)) continue;
+        sendCommand(command);
+    }
+    blockMode = state.blockMode;
+    gridSize = state.gridSize;
+    palette = state.palette;
+    doubleBuffered = state.doubleBuffered;
+    
+    // the leds which differ, as one frame
+    frameNumber++;
+    if (dropStaleFrames) dropQueuedFrames();
+    Array<LightpadCommand> commands;
+    FrameEncoder::encode(ledFrame, state.ledFrame, commands);
+    ledFrame = state.ledFrame;
+    for (auto& command : commands) {
+        sendCommand(command, true);
+    }
+    if (doubleBuffered && commands.size()>0) swapBuffers();
+    return true;
+}
+
+void BlockComponent::setDoubleBuffering(bool on) {
+    // only the Lightpad program has the buffers
+    if (!hasLightpadProgram()) return;
+    doubleBuffered = on;
+    sendStampedMessage(12, 0, 0, 0, on ? 1 : 0);
+}
+
+void BlockComponent::prepareSwap() {
+    if (!doubleBuffered) return;
+    // the swap is sent, when the drawing is on the block
+    swapPending = true;
+    commitTime = Time::getMillisecondCounterHiRes();
+}
+
+void BlockComponent::swapBuffers() {
+    // without buffering the block ignores the swap, the index would differ
+    if (!doubleBuffered) return;
+    // the block only swaps, if the buffer is not already shown
+    displayBuffer = 1 - displayBuffer;
+    swapTime = Time::getMillisecondCounterHiRes();
+    sendStampedMessage(12, 1, 0, 0, (uint32)displayBuffer);
+}
+
+int BlockComponent::numDrawingMessages() {
+    const MessageManagerLock mmLock;
+    int numMessages = 0;
+    rwLock->enterRead();
+    for (auto &obj : *messageSet) {
+        MemoryBlock *memoryBlock = obj.value.getBinaryData();
+        uint32 command = (((uint32 *)memoryBlock->getData())[0] >> 26) & 0x3F;
+        if (isDrawingCommand(command) || command==17) {
+            numMessages++;
+        }
+    }
+    rwLock->exitRead();
+    // and the ones, which are not sent yet
+    for (auto& queued : lanes[drawingLane]) {
+        if (isDrawingCommand(queued.command.commandNr) || queued.command.commandNr==17) {
+            numMessages++;
+        }
+    }
+    // verified drawing, which isn't checked yet
+    if (dirtyRows!=0) numMessages++;
+    return numMessages;
+}
+
+void BlockComponent::setDrawingVerification(bool on) {
+    sendStampedMessage(16, 0, 0, 0, on ? 1 : 0);
+}
+
+bool BlockComponent::queueChecksums() {
+    // one check of the changed rows after the drawing
+    if (dirtyRows==0) return false;
+    for (auto& queued : lanes[drawingLane]) {
+        if (isBulkCommand(queued.command.commandNr)) return false;
+    }
+    for (int row = 0; row < 15; row += 2) {
+        if ((dirtyRows >> row) & 0x03) {
+            queueMessage(drawingLane, {17, (uint32)row, 0, 0, 0});
+            BlockStats::add(stats.checksumRequests);
+        }
+    }
+    dirtyRows = 0;
+    return true;
+}
+
+void BlockComponent::checkChecksums(const juce::Block::ProgramEventMessage& message) {
+    uint32 stamp = ((uint32)message.values[0] >> 18) & 0x3FFF; // command and subcommand
+    rwLock->enterRead();
+    const var *value = messageSet->getVarPointer(Identifier(String(stamp)));
+    bool current = value!=nullptr && ((const uint32 *)value->getBinaryData()->getData())[0]==(uint32)message.values[0];
+    rwLock->exitRead();
+    // reply to a replaced or resent request
+    if (!current) return;
+    
+    int firstRow = (int)(stamp & 0xFF);
+    LedFrame unknown = ledFrame;
+    int numRows = 0;
+    for (int i = 0; i < 2 && firstRow + i < 15; i++) {
+        if ((uint32)message.values[1 + i]==expectedChecksums[firstRow + i]) continue;
+        // a message of the row got lost, all its leds are sent again
+        for (int x = 0; x < 15; x++) {
+            unknown.setPixel(x, firstRow + i, ~ledFrame.getPixel(x, firstRow + i));
+        }
+        numRows++;
+    }
+    if (numRows==0) return;
+    BlockStats::add(stats.rowsRepaired, numRows);
+    Array<LightpadCommand> commands;
+    FrameEncoder::encode(unknown, ledFrame, commands);
+    internalSend = true;
+    for (auto& command : commands) {
+        sendCommand(command);
+    }
+    internalSend = false;
+}
+
+bool BlockComponent::startRecording(const File& file) {
+    // the callbacks record in the message thread
+    const MessageManagerLock mmLock;
+    stopRecording();
+    recorder = new TrafficRecorder(file);
+    if (!recorder->openedOk()) {
+        delete recorder;
+        recorder = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void BlockComponent::stopRecording() {
+    const MessageManagerLock mmLock;
+    if (recorder==nullptr) return;
+    delete recorder;
+    recorder = nullptr;
+}
+
 void BlockComponent::setFaderValue(int index, float value) {
     sendStampedMessage(3, index-1, 0, 0, (uint32)(value*1e6));
 }
@@ -153,81 +575,413 @@ void BlockComponent::setMixerFaderValue(int index, float value) {
     sendStampedMessage(3, index-1, 0, 2, (uint32)(value*1e6));
 }
 
-void BlockComponent::setSettingsValue(juce::String name, int value) {
+void BlockComponent::readConfigMetaData() {
+    configItems.clear();
+    configOptions.clear();
+    if (block==nullptr) return;
     int maxIndex = block->getMaxConfigIndex();
     for (int i=0; i<maxIndex; i++) {
         Block::ConfigMetaData metaData = block->getLocalConfigMetaData(i);
-        if (metaData.name.removeCharacters(". ").toLowerCase().compare(name.toLowerCase())==0) {
-            int clippedValue = metaData.range.clipValue(value);
-            block->setLocalConfigValue(metaData.item, clippedValue);
-            post((metaData.name + ": %i").toUTF8(), clippedValue);
-            break;
+        String key = metaData.name.removeCharacters(". ").toLowerCase();
+        if (metaData.name.isEmpty() || configItems.contains(key)) continue;
+        ConfigItem configItem;
+        configItem.item = metaData.item;
+        configItem.range = metaData.range;
+        configItem.name = metaData.name;
+        for (int j = 0; j < (int)metaData.numOptionNames; j++) {
+            configItem.optionNames.add(metaData.optionNames[j]);
+            String optionKey = key + " " + metaData.optionNames[j].removeCharacters("- ").toLowerCase();
+            if (!configOptions.contains(optionKey)) {
+                configOptions.set(optionKey, j);
+            }
         }
+        configItems.set(key, configItem);
     }
 }
 
-void BlockComponent::setSettingsValue(juce::String name, juce::String option) {
-    int maxIndex = block->getMaxConfigIndex();
-    for (int i=0; i<maxIndex; i++) {
-        Block::ConfigMetaData metaData = block->getLocalConfigMetaData(i);
-        if (metaData.name.removeCharacters(". ").toLowerCase().compare(name.toLowerCase())==0) {
-            for (int j = 0; j < metaData.numOptionNames; j++) {
-                if (metaData.optionNames[j].removeCharacters("- ").toLowerCase().compare(option.toLowerCase())==0) {
-                    block->setLocalConfigValue(metaData.item, j);
-                    post((metaData.name + ": " + metaData.optionNames[j]).toUTF8());
-                    break;
-                }
-            }
+bool BlockComponent::setSettingsValue(juce::String name, int value, bool verbose) {
+    if (block==nullptr) return false;
+    String key = name.toLowerCase();
+    // the metadata can arrive after connecting
+    if (!configItems.contains(key)) readConfigMetaData();
+    if (!configItems.contains(key)) return false;
+    ConfigItem configItem = configItems[key];
+    int clippedValue = configItem.range.clipValue(value);
+    if (block->getLocalConfigValue(configItem.item)==clippedValue) return false;
+    block->setLocalConfigValue(configItem.item, clippedValue);
+    if (verbose) post((configItem.name + ": %i").toUTF8(), clippedValue);
+    return true;
+}
+
+bool BlockComponent::setSettingsValue(juce::String name, juce::String option, bool verbose) {
+    if (block==nullptr) return false;
+    String key = name.toLowerCase();
+    String optionKey = key + " " + option.toLowerCase();
+    if (!configOptions.contains(optionKey)) readConfigMetaData();
+    if (!configOptions.contains(optionKey)) return false;
+    ConfigItem configItem = configItems[key];
+    int index = configOptions[optionKey];
+    if (block->getLocalConfigValue(configItem.item)==index) return false;
+    block->setLocalConfigValue(configItem.item, index);
+    if (verbose) post((configItem.name + ": " + configItem.optionNames[index]).toUTF8());
+    return true;
+}
+
+void BlockComponent::queueSettingsValue(juce::String name, int value, bool verbose) {
+    PendingSetting setting = { name, value, String(), false, verbose };
+    const ScopedLock lock(settingsLock);
+    pendingSettings.add(setting);
+    triggerAsyncUpdate();
+}
+
+void BlockComponent::queueSettingsValue(juce::String name, juce::String option, bool verbose) {
+    PendingSetting setting = { name, 0, option, true, verbose };
+    const ScopedLock lock(settingsLock);
+    pendingSettings.add(setting);
+    triggerAsyncUpdate();
+}
+
+void BlockComponent::handleAsyncUpdate() {
+    Array<PendingSetting> settings;
+    {
+        const ScopedLock lock(settingsLock);
+        settings.swapWith(pendingSettings);
+    }
+    TraceSpan span("settings");
+    // settings of a preset are not posted one by one
+    int numQuiet = 0;
+    int numQuietChanged = 0;
+    for (const PendingSetting& setting : settings) {
+        bool changed = setting.isOption ? setSettingsValue(setting.name, setting.option, setting.verbose)
+                                        : setSettingsValue(setting.name, setting.value, setting.verbose);
+        if (!setting.verbose) {
+            numQuiet++;
+            if (changed) numQuietChanged++;
         }
     }
+    span.value = settings.size();
+    if (numQuiet>0) {
+        post("%s preset: %i of %i settings changed", pdName->toStdString().c_str(), numQuietChanged, numQuiet);
+    }
 }
 
-void BlockComponent::outputInfos() {
+void BlockComponent::outputInfos(bool onlyChanged) {
+    if (block==nullptr) return;
     t_symbol *name = gensym(pdName->toStdString().c_str());
 
-    float batteryLevel = block->getBatteryLevel();
+    const char *keys[4] = { "battery", "rotation", "master", "charging" };
+    float infos[4] = {
+        block->getBatteryLevel(),
+        (float)block->getRotation(),
+        (float)block->isMasterBlock(),
+        (float)block->isBatteryCharging()
+    };
     t_atom at[2];
-    SETSYMBOL(at, gensym("battery"));
-    SETFLOAT(at + 1, (t_float)static_cast<float>(batteryLevel));
-    outlet_anything(out_info, name, 2, at);
-    float rotation = block->getRotation();
-    SETSYMBOL(at, gensym("rotation"));
-    SETFLOAT(at + 1, (t_float)static_cast<float>(rotation));
-    outlet_anything(out_info, name, 2, at);
-    SETSYMBOL(at, gensym("master"));
-    SETFLOAT(at + 1, (t_float)static_cast<float>(block->isMasterBlock()));
-    outlet_anything(out_info, name, 2, at);
-    SETSYMBOL(at, gensym("charging"));
-    SETFLOAT(at + 1, (t_float)static_cast<float>(block->isBatteryCharging()));
-    outlet_anything(out_info, name, 2, at);
+    for (int i = 0; i < 4; i++) {
+        if (onlyChanged && infos[i]==lastInfos[i]) continue;
+        lastInfos[i] = infos[i];
+        SETSYMBOL(at, gensym(keys[i]));
+        SETFLOAT(at + 1, (t_float)infos[i]);
+        outlet_anything(out_info, name, 2, at);
+    }
 }
 
-void BlockComponent::sendStampedMessage(juce::uint32 commandNr, juce::uint32 subCommandNr, juce::uint8 param1, juce::uint32 param2, juce::uint32 param3) {
-    const MessageManagerLock *mmLock = new MessageManagerLock();
+void BlockComponent::outputStats() {
+    rwLock->enterRead();
+    int inFlight = messageSet->size();
+    rwLock->exitRead();
+
+    struct Stat
+    {
+        const char *name;
+        float values[3];
+        int numValues;
+    };
+    Stat list[] = {
+        {"sent", {(float)stats.messagesSent.load(std::memory_order_relaxed)}, 1},
+        {"bytes", {(float)stats.bytesSent.load(std::memory_order_relaxed)}, 1},
+        {"acks", {(float)stats.acksReceived.load(std::memory_order_relaxed)}, 1},
+        {"unknownacks", {(float)stats.unknownAcks.load(std::memory_order_relaxed)}, 1},
+        {"staleacks", {(float)stats.staleAcks.load(std::memory_order_relaxed)}, 1},
+        {"coalesced", {(float)stats.coalesced.load(std::memory_order_relaxed)}, 1},
+        {"resent", {(float)stats.retransmissions.load(std::memory_order_relaxed)}, 1},
+        {"stalls", {(float)stats.stalls.load(std::memory_order_relaxed)}, 1},
+        {"verify", {(float)stats.checksumRequests.load(std::memory_order_relaxed), (float)stats.rowsRepaired.load(std::memory_order_relaxed)}, 2},
+        {"frames", {(float)stats.framesSubmitted.load(std::memory_order_relaxed), (float)stats.framesDropped.load(std::memory_order_relaxed)}, 2},
+        {"inflight", {(float)inFlight}, 1},
+        {"rate", {(float)rate, (float)maxRate}, 2},
+        {"resenddue", {(float)stats.resendDue.load(std::memory_order_relaxed)}, 1},
+        {"pdqueue", {(float)stats.pdWaiting.load(std::memory_order_relaxed), (float)stats.pdWaitingMax.load(std::memory_order_relaxed)}, 2},
+        {"touches", {(float)stats.touchesReceived.load(std::memory_order_relaxed), (float)stats.touchesDelivered.load(std::memory_order_relaxed)}, 2}
+    };
+
+    // [blockname] stats [name] [values]
+    t_symbol *name = gensym(pdName->toStdString().c_str());
+    for (auto& stat : list) {
+        t_atom at[5];
+        SETSYMBOL(at, gensym("stats"));
+        SETSYMBOL(at + 1, gensym(stat.name));
+        for (int i = 0; i < stat.numValues; i++) {
+            SETFLOAT(at + 2 + i, (t_float)stat.values[i]);
+        }
+        outlet_anything(out_info, name, 2 + stat.numValues, at);
+    }
+    
+    // [blockname] stats ack / touchlatency [count] [min] [avg] [p50] [p90] [p99] [max] in ms
+    struct Latency
+    {
+        const char *name;
+        const LatencyHistogram& histogram;
+    };
+    Latency latencies[] = {
+        {"ack", stats.ackLatency},
+        {"touchlatency", stats.touchLatency}
+    };
+    for (auto& latency : latencies) {
+        const LatencyHistogram& histogram = latency.histogram;
+        t_atom at[9];
+        SETSYMBOL(at, gensym("stats"));
+        SETSYMBOL(at + 1, gensym(latency.name));
+        SETFLOAT(at + 2, (t_float)histogram.getCount());
+        SETFLOAT(at + 3, (t_float)(histogram.getMin() / 1000.0));
+        SETFLOAT(at + 4, (t_float)(histogram.getMean() / 1000.0));
+        SETFLOAT(at + 5, (t_float)(histogram.getPercentile(50) / 1000.0));
+        SETFLOAT(at + 6, (t_float)(histogram.getPercentile(90) / 1000.0));
+        SETFLOAT(at + 7, (t_float)(histogram.getPercentile(99) / 1000.0));
+        SETFLOAT(at + 8, (t_float)(histogram.getMax() / 1000.0));
+        outlet_anything(out_info, name, 9, at);
+    }
+    
+    // [blockname] stats lane [lane] [sent] [waiting] [p50] [p99] of the time in the queue in ms
+    const char *laneNames[numLanes] = { "control", "resend", "drawing" };
+    for (int lane = 0; lane < numLanes; lane++) {
+        t_atom at[7];
+        SETSYMBOL(at, gensym("stats"));
+        SETSYMBOL(at + 1, gensym("lane"));
+        SETSYMBOL(at + 2, gensym(laneNames[lane]));
+        SETFLOAT(at + 3, (t_float)stats.laneMessages[lane].load(std::memory_order_relaxed));
+        SETFLOAT(at + 4, (t_float)stats.laneQueued[lane].load(std::memory_order_relaxed));
+        SETFLOAT(at + 5, (t_float)(stats.laneWait[lane].getPercentile(50) / 1000.0));
+        SETFLOAT(at + 6, (t_float)(stats.laneWait[lane].getPercentile(99) / 1000.0));
+        outlet_anything(out_info, name, 7, at);
+    }
+}
+
+void BlockComponent::sendStampedMessage(juce::uint32 commandNr, juce::uint32 subCommandNr, juce::uint8 param1, juce::uint32 param2, juce::uint32 param3, int frame) {
+    TraceSpan span("sendStampedMessage", commandNr);
+    double lockTime = Tracer::isEnabled() ? Tracer::now() : -1;
+    stats.enterWaiting();
+    const MessageManagerLock mmLock;
+    stats.exitWaiting();
+    if (lockTime>=0) Tracer::span("waitForMessageThread", lockTime);
+    
+    LightpadCommand command = { commandNr, subCommandNr, param1, param2, param3 };
+    // the command as the patch sent it, a replay sends it again
+    if (recorder!=nullptr && !internalSend) {
+        Block::ProgramEventMessage message;
+        message.values[0] = (int32)((commandNr << 26) + (subCommandNr << 18) + param1);
+        message.values[1] = (int32)param2;
+        message.values[2] = (int32)param3;
+        recorder->recordMessage(TrafficRecord::sentMessage, message);
+    }
+    int slot = messageSlot(command, false);
+    if (slot>=0) {
+        // a new color mode clears the palette
+        bool wasIndexed = stateCommands.contains(slot) && stateCommands[slot].param3!=0;
+        if (slot==(13 << 16) && wasIndexed!=(param3!=0)) {
+            for (int i = 1; i <= 16; i++) stateCommands.remove(slot + (i << 8));
+        }
+        stateCommands.set(slot, command);
+    }
     
+    // drawing keeps its order, control changes pass it
+    bool drawing = isDrawingCommand(commandNr) || commandNr==12 || commandNr==16 || commandNr==17;
+    queueMessage(drawing ? drawingLane : controlLane, command, frame);
+    sendQueuedMessages();
+}
+
+void BlockComponent::queueMessage(int lane, const LightpadCommand& command, int frame) {
+    // a message waits only once for its resend
+    int slot = lane==resendLane ? (1 << 24) + (int)((command.commandNr << 8) + command.subCommandNr) : messageSlot(command, true);
+    QueuedMessage queued = { command, slot, Time::getMillisecondCounterHiRes(), frame };
+    // the newest value replaces a waiting one, the drawing is moved to the end,
+    // because a message in between can draw on the same led
+    if (queued.slot>=0) {
+        for (int i = lanes[lane].size(); --i >= 0;) {
+            if (lanes[lane].getReference(i).slot==queued.slot) {
+                if (lane!=drawingLane) queued.queueTime = lanes[lane].getReference(i).queueTime;
+                lanes[lane].remove(i);
+                stats.laneQueued[lane].fetch_sub(1, std::memory_order_relaxed);
+                if (lane!=resendLane) BlockStats::add(stats.coalesced);
+                break;
+            }
+        }
+    }
+    lanes[lane].add(queued);
+    stats.laneQueued[lane].fetch_add(1, std::memory_order_relaxed);
+}
+
+bool BlockComponent::isInFlight(const LightpadCommand& command) {
+    uint32 stamp = (command.commandNr << 8) + command.subCommandNr; // command and subcommand
+    rwLock->enterRead();
+    bool inFlight = messageSet->contains(Identifier(String(stamp)));
+    rwLock->exitRead();
+    return inFlight;
+}
+
+void BlockComponent::sendQueuedMessages() {
+    for (int lane = 0; lane < numLanes; lane++) {
+        // a stalled link only gets the control changes, until it echos the probe
+        if (linkHealth==stalledLink && lane!=controlLane) return;
+        int i = 0;
+        while (lanes[lane].size()>i) {
+            if (lane!=resendLane) {
+                // the drawing waits for the echos, so it doesn't delay the other lanes at the block
+                rwLock->enterRead();
+                int inFlight = messageSet->size();
+                rwLock->exitRead();
+                if (lane==drawingLane && inFlight>=maxInFlight) return;
+                // and the control changes, when the link doesn't keep up
+                if (inFlight>=maxTracked) break;
+            }
+            if (lane==controlLane && isInFlight(lanes[lane].getReference(i).command)) {
+                // one value per target on the link, the waiting one can still be replaced
+                i++;
+                continue;
+            }
+            if (!takeToken()) {
+                // sent by the timer
+                rateLimited = true;
+                return;
+            }
+            QueuedMessage queued = lanes[lane].removeAndReturn(i);
+            stats.laneQueued[lane].fetch_sub(1, std::memory_order_relaxed);
+            BlockStats::add(stats.laneMessages[lane]);
+            stats.laneWait[lane].add((int64)((Time::getMillisecondCounterHiRes() - queued.queueTime) * 1000.0));
+            transmitMessage(queued.command, lane==resendLane);
+        }
+    }
+}
+
+bool BlockComponent::takeToken() {
+    if (maxRate<=0) return true;
+    double now = Time::getMillisecondCounterHiRes();
+    // 20 ms of messages at once
+    double bucketSize = jmax(4.0, rate * 0.02);
+    tokens = jmin(bucketSize, tokens + (now - lastRefillTime) * rate / 1000.0);
+    lastRefillTime = now;
+    if (tokens<1) return false;
+    tokens -= 1;
+    return true;
+}
+
+void BlockComponent::setMaxRate(double messagesPerSecond) {
+    const MessageManagerLock mmLock;
+    defaultMaxRate = messagesPerSecond<0;
+    if (defaultMaxRate) {
+        // what the connection carries without overrunning its buffers
+        if (block==nullptr) messagesPerSecond = 0;
+        else messagesPerSecond = block->isConnectedViaBluetooth() ? bluetoothRate : usbRate;
+    }
+    maxRate = messagesPerSecond;
+    rate = maxRate;
+    tokens = jmax(4.0, rate * 0.02);
+    lastRefillTime = Time::getMillisecondCounterHiRes();
+}
+
+void BlockComponent::adaptRate(int numDue) {
+    if (maxRate<=0) return;
+    double now = Time::getMillisecondCounterHiRes();
+    if (numDue>0) {
+        // messages were lost: less, but only once per round trip of the resends
+        if (now - lastDecreaseTime>=200) {
+            rate = jmax(maxRate * 0.1, rate * 0.7);
+            lastDecreaseTime = now;
+        }
+    } else if (rateLimited) {
+        // messages waited for tokens without loss: a bit more
+        rate = jmin(maxRate, rate + maxRate * 0.05);
+    }
+    rateLimited = false;
+}
+
+int BlockComponent::numQueuedMessages() {
+    const MessageManagerLock mmLock;
+    int numQueued = 0;
+    for (auto& lane : lanes) {
+        numQueued += lane.size();
+    }
+    return numQueued;
+}
+
+void BlockComponent::transmitMessage(const LightpadCommand& command, bool resent) {
     // new: 6bit command nr, 8bit subcommand nr, 10bit timestamp, 8bit data byte ( receive 23bit data )
     
-    juce::Block::ProgramEventMessage *message = new juce::Block::ProgramEventMessage();
+    juce::Block::ProgramEventMessage message;
     uint32 millis = Time().getMillisecondCounter();
     millis = (uint32)(millis & 0x3FF) << 8;
-    commandNr = commandNr << 26;
-    subCommandNr = subCommandNr << 18;
-    message->values[0] = millis + commandNr + subCommandNr + param1;
-    message->values[1] = param2;
-    message->values[2] = param3;
-    
-    addMessageToCheck(message);
-    block->sendProgramEvent(*message);
+    uint32 commandNr = command.commandNr << 26;
+    uint32 subCommandNr = command.subCommandNr << 18;
+    message.values[0] = millis + commandNr + subCommandNr + command.param1;
+    message.values[1] = command.param2;
+    message.values[2] = command.param3;
     
-    mmLock->~MessageManagerLock();
-    mmLock = nullptr;
+    if (quietDrawing && isBulkCommand(command.commandNr)) {
+        // no echo, the rows it draws are checked afterwards. Also the rows of
+        // a repair, which doesn't change the sent leds: the leds it draws are
+        // the same on the sent leds and on their inverse
+        LedFrame inverse = sentFrame;
+        for (int i = 0; i < 225; i++) {
+            inverse.drawLED(i, ~sentFrame.getLED(i));
+        }
+        FrameEncoder::apply(command, sentFrame);
+        FrameEncoder::apply(command, inverse);
+        for (int y = 0; y < 15; y++) {
+            for (int x = 0; x < 15; x++) {
+                if (sentFrame.getPixel(x, y)==inverse.getPixel(x, y)) {
+                    dirtyRows |= 1 << y;
+                    break;
+                }
+            }
+        }
+    } else {
+        addMessageToCheck(&message);
+        if (!resent) FrameEncoder::apply(command, sentFrame);
+    }
+    if (command.commandNr==16) {
+        quietDrawing = command.param3!=0;
+    } else if (command.commandNr==17) {
+        // the rows on the block at this message
+        for (int row = (int)command.subCommandNr; row < jmin(15, (int)command.subCommandNr + 2); row++) {
+            expectedChecksums[row] = sentFrame.getRowChecksum(row);
+        }
+    }
+    BlockStats::add(stats.messagesSent);
+    BlockStats::add(stats.bytesSent, sizeof(message.values));
+    if (resent) BlockStats::add(stats.retransmissions);
+    if (recorder!=nullptr) {
+        recorder->recordMessage(resent ? TrafficRecord::resentMessage : TrafficRecord::transmittedMessage, message);
+    }
+    {
+        // to the midi output of the sdk, the echo ends the flow
+        TraceSpan sendSpan("sendProgramEvent");
+        Tracer::flowStart("message", (uint32)message.values[0]);
+        if (link!=nullptr) link->sendProgramEvent(message);
+        else block->sendProgramEvent(message);
+    }
 }
 
+void BlockComponent::sendCommand(const LightpadCommand& command, bool frameCommand) {
+    sendStampedMessage(command.commandNr, command.subCommandNr, command.param1, command.param2, command.param3, frameCommand ? frameNumber : 0);
+}
 
 void BlockComponent::addMessageToCheck(juce::Block::ProgramEventMessage *message) {
     rwLock->enterWrite();
     uint32 stamp = (message->values[0] >> 18 ) & 0x3FFF; // command and subcommand
     MemoryBlock *memoryBlock = new MemoryBlock(message->values, sizeof(int32)*3);
+    // followed by the send time for the latency
+    double sendTime = Time::getMillisecondCounterHiRes();
+    memoryBlock->append(&sendTime, sizeof(double));
     var *value = new var(*memoryBlock);
     String *name = new String(stamp);
     Identifier *identifier = new Identifier(*name);
@@ -238,8 +992,24 @@ void BlockComponent::addMessageToCheck(juce::Block::ProgramEventMessage *message
 }
 
 void BlockComponent::timerCallback() {
+    // the tokens of the paced messages
+    sendQueuedMessages();
+    // the verified drawing is sent
+    if (queueChecksums()) sendQueuedMessages();
+    double now = Time::getMillisecondCounterHiRes();
+    if (now - lastResendCheck>=50) {
+        lastResendCheck = now;
+        checkResends();
+    }
+}
+
+void BlockComponent::checkResends() {
+    TraceSpan span("resendScan");
+    int numDue = 0;
     rwLock->enterWrite();
+    // nothing is resent to a stalled link, it is probed instead
     for (auto &obj : *messageSet) {
+        if (linkHealth==stalledLink) break;
         var value = obj.value;
         MemoryBlock *memoryBlock = value.getBinaryData();
         void *values = memoryBlock->getData();
@@ -250,19 +1020,111 @@ void BlockComponent::timerCallback() {
         int diff = now - millis;
         if (diff<0) diff += 1023;
         if (diff>100) {
+            numDue++;
             uint32 command = (param1 >> 26) & 0x3F;
             uint32 subCommand = (param1 >> 18) & 0xFF;
             uint8 param1 = ((uint32 *)values)[0] & 0x000000ff;
             uint32 param2 = ((uint32 *)values)[1];
             uint32 param3 = ((uint32 *)values)[2];
             //post("should resend packet %u - %u / %u - %u / %i", command, subCommand, param2, param3, diff);
-            sendStampedMessage(command, subCommand, param1, param2, param3);
+            LightpadCommand resend = { command, subCommand, param1, param2, param3 };
+            queueMessage(resendLane, resend);
         }
     }
     rwLock->exitWrite();
+    adaptRate(numDue);
+    checkLinkHealth(numDue);
+    // sending changes the message set
+    sendQueuedMessages();
+    stats.resendDue.store(numDue, std::memory_order_relaxed);
+    span.value = numDue;
+}
+
+void BlockComponent::checkLinkHealth(int numDue) {
+    double now = Time::getMillisecondCounterHiRes();
+    if (linkHealth==stalledLink) {
+        if (now - lastProbeTime>=probeInterval) {
+            // one message, which the program only echoes
+            lastProbeTime = now;
+            transmitMessage({18, 0, 0, 0, 0}, false);
+        }
+        return;
+    }
+    rwLock->enterRead();
+    bool waiting = messageSet->size()>0;
+    rwLock->exitRead();
+    // nothing to wait for
+    if (!waiting) lastAckTime = now;
+    
+    if (now - lastAckTime>=stallTimeout) {
+        setLinkHealth(stalledLink);
+    } else if (numDue>0) {
+        lastCongestionTime = now;
+        setLinkHealth(congestedLink);
+    } else if (now - lastCongestionTime>=1000) {
+        setLinkHealth(healthyLink);
+    }
+}
+
+void BlockComponent::setLinkHealth(LinkHealth health) {
+    if (health==linkHealth) return;
+    linkHealth = health;
+    if (health==stalledLink) {
+        BlockStats::add(stats.stalls);
+        lastProbeTime = 0;
+    }
+    const char *names[] = {"healthy", "congested", "stalled"};
+    t_atom at[2];
+    SETSYMBOL(at, gensym("link"));
+    SETSYMBOL(at + 1, gensym(names[health]));
+    t_symbol *name = gensym(pdName->toStdString().c_str());
+    outlet_anything(out_info, name, 2, at);
+}
+
+void BlockComponent::resyncState() {
+    // the waiting messages and drawing are replaced by the state
+    rwLock->enterWrite();
+    messageSet->clear();
+    rwLock->exitWrite();
+    for (int lane = resendLane; lane < numLanes; lane++) {
+        stats.laneQueued[lane].fetch_sub(lanes[lane].size(), std::memory_order_relaxed);
+        lanes[lane].clear();
+    }
+    dirtyRows = 0;
+    internalSend = true;
+    
+    Array<int> slots;
+    for (HashMap<int, LightpadCommand>::Iterator i(stateCommands); i.next();) {
+        slots.add(i.getKey());
+    }
+    slots.sort();
+    for (int slot : slots) {
+        sendCommand(stateCommands[slot]);
+    }
+    // every led, the block can show anything
+    LedFrame unknown = ledFrame;
+    for (int i = 0; i < 225; i++) {
+        unknown.drawLED(i, ~ledFrame.getLED(i));
+    }
+    sentFrame = unknown;
+    Array<LightpadCommand> commands;
+    FrameEncoder::encode(unknown, ledFrame, commands);
+    for (auto& command : commands) {
+        sendCommand(command);
+    }
+    // a swap is only done, if the buffer isn't shown already
+    if (doubleBuffered) sendStampedMessage(12, 1, 0, 0, (uint32)displayBuffer);
+    internalSend = false;
 }
 
 void BlockComponent::checkMessages(int param1) {
+    // the link works again
+    lastAckTime = Time::getMillisecondCounterHiRes();
+    bool resync = linkHealth==stalledLink;
+    if (resync) {
+        lastCongestionTime = lastAckTime;
+        setLinkHealth(congestedLink);
+    }
     rwLock->enterWrite();
     uint32 stamp = (param1 >> 18 ) & 0x3FFF; // command and subcommand
     uint32 millis = (param1 >> 8) & 0x3FF;
@@ -271,23 +1133,70 @@ void BlockComponent::checkMessages(int param1) {
     Identifier *identifier = new Identifier(*name);
     uint32 command = (param1 >> 26 ) & 0x3F; // command
 
+    bool drawingReceived = false;
+    bool swapReceived = false;
     if (messageSet->contains(*identifier)) {
         uint32 now = Time().getMillisecondCounter();
         now = (uint32)(now & 0x3FF);
         int diff = now - millis;
         if (diff<0) diff += 1023;
+        BlockStats::add(stats.acksReceived);
+        // the stamp has only 10 bit ms, use the send time, if it's the echo of this message
+        const void *values = messageSet->getVarPointer(*identifier)->getBinaryData()->getData();
+        if (((const uint32 *)values)[0]==(uint32)param1) {
+            double sendTime;
+            memcpy(&sendTime, (const uint8 *)values + sizeof(int32)*3, sizeof(double));
+            stats.ackLatency.add((int64)((Time::getMillisecondCounterHiRes() - sendTime) * 1000.0));
+        } else {
+            stats.ackLatency.add((int64)diff * 1000);
+        }
         //printf("got message %i returned: (time: %i)\n", messageSet->indexOf(*identifier), diff);
-        if (command>=4 && command<=8) {
+        // drawing and swapping has to be in the right order
+        bool isSwap = command==12 && (stamp & 0xFF)==1;
+        if (((const uint32 *)values)[0]!=(uint32)param1) {
+            // echo of an earlier message with the same command and subcommand,
+            // which was replaced or resent: only the echo of the last one counts
+            BlockStats::add(stats.staleAcks);
+        } else if (isDrawingCommand(command) || isSwap) {
             if (messageSet->indexOf(*identifier)==0) {
                 messageSet->remove(*identifier);
+                drawingReceived = true;
+                swapReceived = isSwap;
             }
         } else {
             messageSet->remove(*identifier);
+            // the checked drawing
+            drawingReceived = command==17;
         }
     } else {
         //printf("didn't found the message\n");
+        BlockStats::add(stats.unknownAcks);
+        Tracer::instant("unknownAck", stamp);
     }
     rwLock->exitWrite();
+    
+    if (resync) {
+        // the echo is counted, the rest is replaced by the state
+        resyncState();
+    } else {
+        // room for the waiting drawing
+        sendQueuedMessages();
+    }
+    
+    if (drawingReceived && listener!=nullptr) {
+        listener->drawingAcknowledged(*this);
+    }
+    if (swapReceived && swapPending) {
+        // commit latency: total and waiting for the drawing
+        swapPending = false;
+        double now = Time::getMillisecondCounterHiRes();
+        t_atom at[3];
+        SETSYMBOL(at, gensym("commit"));
+        SETFLOAT(at + 1, (t_float)(now - commitTime));
+        SETFLOAT(at + 2, (t_float)(swapTime - commitTime));
+        t_symbol *name = gensym(pdName->toStdString().c_str());
+        outlet_anything(out_info, name, 3, at);
+    }
 }
 
 int BlockComponent::padIndexForTouch(const TouchSurface::Touch& t) {
@@ -299,6 +1208,13 @@ int BlockComponent::padIndexForTouch(const TouchSurface::Touch& t) {
 // juce::TouchSurface::Listener
 
 void BlockComponent::touchChanged (TouchSurface&, const TouchSurface::Touch& t) {
+    receiveTouch(t);
+}
+
+void BlockComponent::receiveTouch(const TouchSurface::Touch& t) {
+    TraceSpan span("touch", t.index);
+    if (recorder!=nullptr) recorder->recordTouch(t);
+    BlockStats::add(stats.touchesReceived);
     if (t.isTouchStart) {
         if (blockMode==mDrumpads) {
             int padIndex = padIndexForTouch(t);
@@ -309,6 +1225,7 @@ void BlockComponent::touchChanged (TouchSurface&, const TouchSurface::Touch& t)
             SETFLOAT(at + 2, (t_float)t.zVelocity);
             t_symbol *name = gensym(pdName->toStdString().c_str());
             outlet_anything(out_action, name, 3, at);
+            touchDelivered(t);
         }
     } else if (t.isTouchEnd) {
         if (blockMode==mDrumpads) {
@@ -319,6 +1236,7 @@ void BlockComponent::touchChanged (TouchSurface&, const TouchSurface::Touch& t)
             SETFLOAT(at + 2, (t_float)0);
             t_symbol *name = gensym(pdName->toStdString().c_str());
             outlet_anything(out_action, name, 3, at);
+            touchDelivered(t);
         }
     } else {
         if (blockMode==mDrumpads) {
@@ -334,10 +1252,15 @@ void BlockComponent::touchChanged (TouchSurface&, const TouchSurface::Touch& t)
                 SETFLOAT(at + 3, z);
                 t_symbol *name = gensym(pdName->toStdString().c_str());
                 outlet_anything(out_action, name, 4, at);
+                touchDelivered(t);
             }
         }
     }
-    if (blockMode==mXYZpad || blockMode==mPaint) {
+    if (blockMode==mPaint && canvas!=nullptr) {
+        // touches in canvas coordinates
+        canvas->touchChanged(*this, t);
+        touchDelivered(t);
+    } else if (blockMode==mXYZpad || blockMode==mPaint) {
         float phase = 2;
         if (t.isTouchStart) phase = 1;
         else if (t.isTouchEnd) phase = 0;
@@ -351,23 +1274,32 @@ void BlockComponent::touchChanged (TouchSurface&, const TouchSurface::Touch& t)
         SETFLOAT(at + 5, (t_float)t.z);
         t_symbol *name = gensym(pdName->toStdString().c_str());
         outlet_anything(out_action, name, 6, at);
+        touchDelivered(t);
     }
 }
 
+void BlockComponent::touchDelivered(const TouchSurface::Touch& t) {
+    BlockStats::add(stats.touchesDelivered);
+    // the sdk converts the time of the touch on the block to the host time
+    int64 age = (int64)(int32)(Time::getMillisecondCounter() - t.eventTimestamp);
+    stats.touchLatency.add(age * 1000);
+}
+
 // juce::ControlButton::Listener
 
 void BlockComponent::buttonPressed  (ControlButton& b, Block::Timestamp t) {
-    t_atom at[2];
-    SETSYMBOL(at, gensym("button"));
-    SETFLOAT(at + 1, (t_float)1);
-    t_symbol *name = gensym(pdName->toStdString().c_str());
-    outlet_anything(out_action, name, 2, at);
+    receiveButton(true);
 }
 
 void BlockComponent::buttonReleased (ControlButton& b, Block::Timestamp t) {
+    receiveButton(false);
+}
+
+void BlockComponent::receiveButton(bool pressed) {
+    if (recorder!=nullptr) recorder->recordButton(pressed);
     t_atom at[2];
     SETSYMBOL(at, gensym("button"));
-    SETFLOAT(at + 1, (t_float)0);
+    SETFLOAT(at + 1, (t_float)(pressed ? 1 : 0));
     t_symbol *name = gensym(pdName->toStdString().c_str());
     outlet_anything(out_action, name, 2, at);
 }
@@ -375,10 +1307,17 @@ void BlockComponent::buttonReleased (ControlButton& b, Block::Timestamp t) {
 // juce::Block::ProgramEventListener
 
 void BlockComponent::handleProgramEvent (juce::Block &source, const juce::Block::ProgramEventMessage &message) {
-    
+    receiveProgramEvent(message);
+}
+
+void BlockComponent::receiveProgramEvent(const juce::Block::ProgramEventMessage &message) {
+    if (recorder!=nullptr) recorder->recordMessage(TrafficRecord::receivedMessage, message);
     uint32 command = (message.values[0] >> 26 ) & 0x3F; // command
-    if (command<10) {
+    TraceSpan span("receiveProgramEvent", command);
+    if (command!=10 && command!=11) {
         // return packets
+        Tracer::flowEnd("message", (uint32)message.values[0]);
+        if (command==17) checkChecksums(message);
         checkMessages(message.values[0]);
     } else {
         // commands from blocks
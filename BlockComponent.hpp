@@ -6,20 +6,41 @@
 //  Copyright © 2020 Urban Lienert. All rights reserved.
 //
 
+#pragma once
+
 #include <BlocksHeader.h>
 #include "m_pd.h"
 #include "LightpadProgram.hpp"
+#include "LedFrame.hpp"
+#include "LightpadLink.hpp"
+#include "TrafficRecorder.hpp"
+#include "BlockStats.hpp"
+
+class BlockCanvas;
 
 class BlockComponent : private juce::TouchSurface::Listener,
                        private juce::ControlButton::Listener,
                        private juce::Block::ProgramEventListener,
-                       private juce::Timer
+                       private juce::Timer,
+                       private juce::AsyncUpdater
 {
 public:
     BlockComponent (juce::Block::Ptr blockToUse, bool loadProgram);
+    // Lightpad without a block, e.g. the emulator
+    BlockComponent (LightpadLink *linkToUse, juce::String name);
     ~BlockComponent();
     
+    // gets called in the message thread
+    struct Listener
+    {
+        virtual ~Listener() {}
+        // all drawing commands were received by the block
+        virtual void drawingAcknowledged(BlockComponent& component) = 0;
+    };
+    Listener *listener;
+    
     juce::Block::Ptr block;
+    LightpadLink *link;
     juce::String *pdName;
     
     b_mode blockMode;
@@ -31,6 +52,23 @@ public:
     
     juce::NamedValueSet *messageSet;
     
+    // canvas the block belongs to (or nullptr)
+    BlockCanvas *canvas;
+    
+    // copy of the led store on the block (the hidden buffer with double buffering)
+    LedFrame ledFrame;
+    
+    // double buffering of the led store
+    bool doubleBuffered;
+    int displayBuffer;
+    bool swapPending;
+    double commitTime;
+    double swapTime;
+    
+    // 16 color palette instead of rgb leds
+    bool indexedColor;
+    juce::Array<juce::uint32> palette;
+    
     // set Programm as default
     void setDefault();
     
@@ -59,23 +97,217 @@ public:
     void hideNumberColor();
     void clearScreen();
     
-    // set Local Settings
-    void setSettingsValue(juce::String name, int value);
-    void setSettingsValue(juce::String name, juce::String option);
+    // send the leds, which are different to the led store
+    void uploadFrame(const LedFrame& frame);
+    void addFrameCommands(const LedFrame& frame, juce::Array<LightpadCommand>& commands);
+    
+    // with dropStaleFrames a new frame discards the waiting messages of the older
+    // frames and is encoded against the leds sent so far, so an animation on a slow
+    // link skips frames instead of falling behind. Frame commands are sent with
+    // sendCommand(command, true)
+    bool dropStaleFrames;
+    
+    // palette colors, leds are drawn with the nearest palette color
+    void setColorMode(bool indexed);
+    void setPalette(juce::OwnedArray<juce::LEDColour>* colors);
+    void setPixels(int ledNr, const juce::Array<int>& indexes);
+    int nearestPaletteIndex(juce::uint32 colour);
+    juce::uint32 deviceColor(juce::uint32 argb);
+    
+    // double buffering, drawing is shown after swapping the buffers (only
+    // Lightpads, the swaps do nothing without double buffering)
+    void setDoubleBuffering(bool on);
+    void prepareSwap();
+    void swapBuffers();
+    int numDrawingMessages();
+    
+    // verified drawing: the block doesn't echo leds, packed leds and runs. After the
+    // drawing (checked by the timer) the checksums of the changed rows are compared
+    // with the copy in one round trip and only the rows, which differ, are sent again
+    void setDrawingVerification(bool on);
+    
+    // capture of the messages, touches and buttons (or nullptr)
+    TrafficRecorder *recorder;
+    bool startRecording(const juce::File& file);
+    void stopRecording();
+    
+    // state of a Lightpad, which the finder keeps by serial number after the
+    // block disconnected, to restore it when the block reconnects
+    struct RetainedState
+    {
+        b_mode blockMode;
+        int gridSize;
+        bool indexedColor;
+        juce::Array<juce::uint32> palette;
+        bool doubleBuffered;
+        bool dropStaleFrames;
+        // last message of each slot, e.g. mode, pad colours, faders, number overlay
+        juce::Array<LightpadCommand> commands;
+        LedFrame ledFrame;
+    };
+    RetainedState retainState();
+    // sends the state messages and the leds, which differ from a blank block
+    void restoreState(const RetainedState& state);
+    
+    // snapshots of the state by number, a recall sends only the state messages
+    // and leds which differ from the current state (the verified drawing and
+    // dropframes are not part of a scene)
+    struct Scene
+    {
+        int number;
+        RetainedState state;
+    };
+    juce::Array<Scene> scenes;
+    void storeScene(int number);
+    // false, if there is no scene with the number
+    bool recallScene(int number);
+    
+    // set Local Settings, returns false if the setting is unknown or unchanged
+    bool setSettingsValue(juce::String name, int value, bool verbose = true);
+    bool setSettingsValue(juce::String name, juce::String option, bool verbose = true);
+    
+    // queue settings from the Pd thread, they are set in the message thread
+    // and only the changed values are sent to the block
+    void queueSettingsValue(juce::String name, int value, bool verbose);
+    void queueSettingsValue(juce::String name, juce::String option, bool verbose);
+    
+    // config metadata by lower case name without ". " (options without "- "),
+    // read on connect and when the topology changes
+    struct ConfigItem
+    {
+        juce::uint32 item;
+        juce::Range<juce::int32> range;
+        juce::String name;
+        juce::StringArray optionNames;
+    };
+    juce::HashMap<juce::String, ConfigItem> configItems;
+    // "[name] [option]" to the option index
+    juce::HashMap<juce::String, int> configOptions;
+    void readConfigMetaData();
 
-    // output Infos
-    void outputInfos();
+    // output Infos, with onlyChanged only the ones which changed since the last output
+    void outputInfos(bool onlyChanged = false);
+    
+    // counters of the message handling
+    BlockStats stats;
+    void outputStats();
     
     // messages
     void addMessageToCheck(juce::Block::ProgramEventMessage *message);
     void checkMessages(int param1);
     void timerCallback() override;
-    void sendStampedMessage(juce::uint32 commandNr, juce::uint32 subCommandNr, juce::uint8 param1, juce::uint32 param2, juce::uint32 param3);
+    void checkResends();
+    void sendStampedMessage(juce::uint32 commandNr, juce::uint32 subCommandNr, juce::uint8 param1, juce::uint32 param2, juce::uint32 param3, int frame = 0);
+    void sendCommand(const LightpadCommand& command, bool frameCommand = false);
+    
+    // messages are sent by priority lane (see MessageLane): control changes first,
+    // then resends and the drawing, while less than maxInFlight messages wait for their echo.
+    // A waiting message is replaced by a newer one for the same target (e.g. a fader or
+    // a led) and a control change waits, while the last one for its target is in flight
+    static const int maxInFlight = 32;
+    // control changes wait, while this many messages wait for their echo
+    static const int maxTracked = 64;
+    int numQueuedMessages();
+    
+    // health of the link to the block, sent to the info outlet when it changes:
+    // congested while messages get lost, stalled when nothing was echoed for
+    // stallTimeout ms. A stalled link gets no resends and no drawing, only a ping
+    // every probeInterval ms, and after its echo the state is sent again
+    enum LinkHealth
+    {
+        healthyLink,
+        congestedLink,
+        stalledLink
+    };
+    static const int stallTimeout = 1000;
+    static const int probeInterval = 250;
+    LinkHealth linkHealth;
+    
+    // pacing with a token bucket: the rate adapts between 10% and 100% of maxRate,
+    // less after messages were lost and more while messages wait for tokens
+    static const int usbRate = 2000;
+    static const int bluetoothRate = 400;
+    double maxRate;     // messages per second, 0 for no limit
+    double rate;
+    bool defaultMaxRate;
+    // -1 for the rate of the connection
+    void setMaxRate(double messagesPerSecond);
+    
+    // events from the block (or the emulator)
+    void receiveProgramEvent(const juce::Block::ProgramEventMessage& message);
+    void receiveTouch(const juce::TouchSurface::Touch& t);
+    void receiveButton(bool pressed);
     
     juce::ReadWriteLock *rwLock;
     
 private:
+    struct QueuedMessage
+    {
+        LightpadCommand command;
+        int slot;           // heap target, a newer message of the same slot replaces it
+        double queueTime;
+        int frame;          // number of the frame it belongs to, 0 for other messages
+    };
+    juce::Array<QueuedMessage> lanes[numLanes];
+    void queueMessage(int lane, const LightpadCommand& command, int frame = 0);
+    void sendQueuedMessages();
+    bool isInFlight(const LightpadCommand& command);
+    
+    double tokens;
+    double lastRefillTime;
+    double lastDecreaseTime;
+    double lastResendCheck;
+    bool rateLimited;
+    bool takeToken();
+    void adaptRate(int numDue);
+    
+    double lastAckTime;
+    double lastCongestionTime;
+    double lastProbeTime;
+    void checkLinkHealth(int numDue);
+    void setLinkHealth(LinkHealth health);
+    // the block may have missed any message: the state and all leds again
+    void resyncState();
+    // repairs and resyncs, which a capture doesn't record as sent by the patch
+    bool internalSend;
+    void transmitMessage(const LightpadCommand& command, bool resent);
+    
+    // the led store after the drawing messages sent so far (resends guarantee,
+    // that they arrive) and the number of the last frame
+    LedFrame sentFrame;
+    int frameNumber;
+    void dropQueuedFrames();
+    
+    // verified drawing is on at the block, rows changed since the last check and
+    // the checksums of the rows at the last request
+    bool quietDrawing;
+    int dirtyRows;
+    juce::uint32 expectedChecksums[15];
+    bool queueChecksums();
+    void checkChecksums(const juce::Block::ProgramEventMessage& message);
+    
+    struct PendingSetting
+    {
+        juce::String name;
+        int value;
+        juce::String option;
+        bool isOption;
+        bool verbose;
+    };
+    juce::CriticalSection settingsLock;
+    juce::Array<PendingSetting> pendingSettings;
+    void handleAsyncUpdate() override;
+    
+    // last state message of each slot (see messageSlot), without the drawing
+    juce::HashMap<int, LightpadCommand> stateCommands;
+    
+    // battery, rotation, master and charging at the last output (-1 before)
+    float lastInfos[4];
+    
+    void initialise();
+    bool hasLightpadProgram();
     int padIndexForTouch(const juce::TouchSurface::Touch& t);
+    void touchDelivered(const juce::TouchSurface::Touch& t);
     
     /** Overridden from TouchSurface::Listener */
     void touchChanged (juce::TouchSurface&, const juce::TouchSurface::Touch& t) override;
@@ -8,92 +8,128 @@
 
 #include "BlockFinder.hpp"
 #include "m_pd.h"
+#include "Tracer.hpp"
 
 using namespace juce;
 
-typedef struct cf_data
-{
-    BlockComponent *component;
-    String name;
-    int value;
-    String option;
-} cf_data;
-
-// callback function for message thread
-void* settingValueFunction (void* d) {
-    cf_data data = *(cf_data *)d;
-    BlockComponent* component = data.component;
-    component->setSettingsValue(data.name, data.value);
-    return nullptr;
-};
-
-void* settingsOptionFunction (void* d) {
-    cf_data data = *(cf_data *)d;
-    BlockComponent* component = data.component;
-    component->setSettingsValue(data.name, data.option);
-    return nullptr;
-};
+// colour from a hex symbol like 0xff0000
+static uint32 argbForAtom(t_atom atom) {
+    return 0xff000000 + String(atom.a_w.w_symbol->s_name).getHexValue32();
+}
 
 BlockFinder::BlockFinder()
 {
     // Register to receive topologyChanged() callbacks from pts.
     pts.addListener (this);
     serialsAndNames = new StringPairArray;
+    statsInterval = 0;
+    lastStatsTime = 0;
+    lastTimerTime = 0;
+    subscribeInterval = 0;
+    lastSubscribeTime = 0;
+    topologyChangedTime = 0;
+    resetStats();
+    startTimer(50);
 }
 
 BlockFinder::~BlockFinder() {
+    canvas.detach();
     pts.setActive(false);
     serialsAndNames->~StringPairArray();
 }
 
 void BlockFinder::topologyChanged()
 {
+    // applied by the timer, when there are no more changes
+    topologyChangedTime = Time::getMillisecondCounterHiRes();
+}
+
+void BlockFinder::updateTopology()
+{
+    topologyChangedTime = 0;
     auto currentTopology = pts.getCurrentTopology();
     
-    for (auto& component : blockComponents) {
-        bool found = false;
-        for (auto& block : currentTopology.blocks) {
-            if (component->block->uid==block->uid) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            blockComponents.removeObject(component);
+    HashMap<int64, Block::Ptr> currentBlocks;
+    for (auto& block : currentTopology.blocks) {
+        currentBlocks.set((int64)block->uid, block);
+    }
+    
+    // removed blocks, a block which reconnected has a new Block object
+    for (int i = blockComponents.size(); --i >= 0;) {
+        BlockComponent *component = blockComponents[i];
+        if (component->block==nullptr) continue;
+        int64 uid = (int64)component->block->uid;
+        if (currentBlocks.contains(uid) && currentBlocks[uid]==component->block) continue;
+        post(("Block removed: " + component->block->getDeviceDescription() + " " + component->block->serialNumber).toUTF8());
+        retainedStates.set(component->block->serialNumber, component->retainState());
+        retainedScenes.set(component->block->serialNumber, component->scenes);
+        componentsByUid.remove(uid);
+        commitComponents.removeFirstMatchingValue(component);
+        // the players without blocks are removed, the others keep playing
+        for (int p = players.size(); --p >= 0;) {
+            players[p]->removeComponent(component);
+            if (!players[p]->hasComponents()) players.remove(p);
         }
+        const ScopedLock lock(componentsLock);
+        blockComponents.remove(i);
     }
 
-    post(("Detected " + String (currentTopology.blocks.size()) + " blocks:").toUTF8());
-    post("");
-
-    for (auto& block : currentTopology.blocks)
-    {
-        post(("    Description:   " + block->getDeviceDescription()).toUTF8());
-        post(("    Serial number: " + block->serialNumber).toUTF8());
-        post("");
-        
-        bool found = false;
-        for (auto& component : blockComponents) {
-            if (component->block->uid==block->uid) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            BlockComponent *component = new BlockComponent(block, loadPrgram);
-            component->out_action = out_A;
-            component->out_info = out_B;
+    // new blocks
+    for (auto& block : currentTopology.blocks) {
+        if (componentsByUid.contains((int64)block->uid)) continue;
+        post(("Block added: " + block->getDeviceDescription() + " " + block->serialNumber).toUTF8());
+        BlockComponent *component = new BlockComponent(block, loadPrgram);
+        component->out_action = out_A;
+        component->out_info = out_B;
+        component->listener = this;
+        {
+            const ScopedLock lock(componentsLock);
             blockComponents.add(component);
         }
+        componentsByUid.set((int64)block->uid, component);
+        // the same Lightpad again, e.g. after a bluetooth dropout
+        if (retainedStates.contains(block->serialNumber)) {
+            component->restoreState(retainedStates[block->serialNumber]);
+            retainedStates.remove(block->serialNumber);
+        }
+        if (retainedScenes.contains(block->serialNumber)) {
+            component->scenes = retainedScenes[block->serialNumber];
+            retainedScenes.remove(block->serialNumber);
+        }
     }
         
     // setting pdNames in components
     updateComponents();
     
+    // the config of a block can change with the topology (e.g. new firmware),
+    // the connection with the master block
+    for (BlockComponent* component : blockComponents) {
+        component->readConfigMetaData();
+        if (component->defaultMaxRate) component->setMaxRate(-1);
+    }
+    
+    if (canvas.isActive()) {
+        canvas.layout(currentTopology, blockComponents);
+        for (BlockComponent* component : blockComponents) {
+            if (component->canvas!=nullptr) {
+                component->setLightpadMode("paint");
+                component->setDoubleBuffering(true);
+            }
+        }
+        canvas.outputLayout(out_B);
+    }
+    
     if (pts.isActive()) {
         // send bang to output
         outlet_bang(out_D);
-        outputTopology();
+        outputTopologyChanges(currentTopology);
+    }
+    
+    // rotation and master change with the topology
+    if (subscribeInterval>0) {
+        for (BlockComponent* component : blockComponents) {
+            component->outputInfos(true);
+        }
     }
 }
 
@@ -103,6 +139,7 @@ void BlockFinder::setPdNameForSerial(const char *serial, const char *name) {
 }
 
 void BlockFinder::doBlockCommand(t_symbol *name, int argc, t_atom *argv) {
+    TraceSpan span("blocks_command");
     // removing list atom, if there is one
     if (String(name->s_name).compare("list")==0) {
         name = argv[0].a_w.w_symbol;
@@ -111,218 +148,749 @@ void BlockFinder::doBlockCommand(t_symbol *name, int argc, t_atom *argv) {
         }
         argc --;
     }
-    // searching for block
-    bool found = false;
+    numCommands.fetch_add(1, std::memory_order_relaxed);
+    // counters of the message handling
+    if (String(name->s_name).compare("stats")==0) {
+        doStatsCommand(argc, argv);
+        return;
+    }
+    // infos of the blocks, when they change
+    if (String(name->s_name).compare("subscribe")==0) {
+        doSubscribeCommand(argc, argv);
+        return;
+    }
+    // chrome trace of the message handling
+    if (String(name->s_name).compare("trace")==0) {
+        doTraceCommand(argc, argv);
+        return;
+    }
+    // canvas of all Lightpads
+    if (String(name->s_name).compare("canvas")==0) {
+        doCanvasCommand(argc, argv);
+        return;
+    }
+    // swap the buffers of multiple blocks
+    if (String(name->s_name).compare("commit")==0) {
+        doCommitCommand(argc, argv);
+        return;
+    }
+    // named groups of blocks
+    if (String(name->s_name).compare("group")==0) {
+        doGroupCommand(argc, argv);
+        return;
+    }
+    String target = String(name->s_name);
+    String command = argc>0 && argv[0].a_type==A_SYMBOL ? String(argv[0].a_w.w_symbol->s_name) : String();
+    // settings are queued, Pd doesn't wait for the message thread
+    if (command.compare("set")==0 || command.compare("preset")==0) {
+        const ScopedLock lock(componentsLock);
+        Array<BlockComponent*> components = componentsForTarget(target);
+        if (components.size()==0) {
+            error("block '%s' not found", name->s_name);
+            return;
+        }
+        doSettingsCommand(components, argc, argv);
+        return;
+    }
+    // the message thread once for all blocks, the blocks can't be removed meanwhile
+    const MessageManagerLock mmLock;
+    Array<BlockComponent*> components = componentsForTarget(target);
+    if (components.size()==0) {
+        error("block '%s' not found", name->s_name);
+        return;
+    }
+    if (command.compare("play")==0) {
+        doPlayCommand(target, components, argc, argv);
+    } else if (command.isNotEmpty()) {
+        doComponentCommand(components, argc, argv);
+    }
+}
+
+Array<BlockComponent*> BlockFinder::componentsForTarget(const String& target) {
+    Array<BlockComponent*> components;
+    // the blocks of a group in its order, e.g. for the images of a frame file
+    if (groups.contains(target)) {
+        for (const String& member : groups[target]) {
+            for (BlockComponent* component : blockComponents) {
+                if (component->pdName->compare(member)==0) components.addIfNotAlreadyThere(component);
+            }
+        }
+        return components;
+    }
     for (BlockComponent* component : blockComponents) {
-        if (component->pdName->compare(name->s_name)==0) {
-            found = true;
-            if (argc>0) {
-                t_atom cAtom = argv[0];
-                if (cAtom.a_type==A_SYMBOL) {
-                    String command = String(cAtom.a_w.w_symbol->s_name);
-                    // set programm as default
-                    if (command.compare("setdefault")==0) {
-                        component->setDefault();
-                        post("setting default program");
-                    }
-                    // mode command
-                    else if (command.compare("mode")==0 && argc>1) {
-                        t_atom pAtom = argv[1];
-                        if (pAtom.a_type==A_SYMBOL) {
-                            component->setLightpadMode(String(pAtom.a_w.w_symbol->s_name));
-                        }
-                        if (argc>2) {
-                            t_atom gAtom = argv[2];
-                            if (pAtom.a_type==A_SYMBOL && gAtom.a_type==A_FLOAT) {
-                                int size = (int)gAtom.a_w.w_float;
-                                if (size<1) size = 1;
-                                if (size>5) size = 5;
-                                component->setGridSize(size);
-                            }
-                        } else {
-                            component->setGridSize(2);
-                        }
-                    }
-                    // color command
-                    else if (command.compare("color")==0 && argc>1) {
-                        // set color for pads, faders, etc.
-                        OwnedArray<LEDColour> *colors = new OwnedArray<LEDColour>();
-                        int numColors = argc - 1;
-                        for (int i=1; i<=numColors; i++) {
-                            t_atom hAtom = argv[i];
-                            if (hAtom.a_type==A_SYMBOL) {
-                                String *hexString = new String(hAtom.a_w.w_symbol->s_name);
-                                uint32 argb = 0xff000000 + hexString->getHexValue32();
-                                LEDColour *color = new LEDColour(argb);
-                                colors->add(color);
-                            }
-                        }
-                        if (colors->size()>0) {
-                            component->setColors(colors);
-                        }
-                        colors->~OwnedArray();
-                    }
-                    // set fader value command
-                    else if (command.compare("fader")==0 && argc>2) {
-                        t_atom fAtom1 = argv[1];
-                        t_atom fAtom2 = argv[2];
-                        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT) {
-                            int index = (int)fAtom1.a_w.w_float;
-                            float value = fAtom2.a_w.w_float;
-                            component->setFaderValue(index, value);
-                        }
-                    }
-                    // set mixer fader and button value command
-                    else if (command.compare("mixer")==0 && argc>3) {
-                        t_atom sAtom = argv[1];
-                        t_atom fAtom1 = argv[2];
-                        t_atom fAtom2 = argv[3];
-                        if (sAtom.a_type==A_SYMBOL && fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT) {
-                            String subCommand = String(sAtom.a_w.w_symbol->s_name);
-                            if (subCommand.compare("button")==0) {
-                                int index = (int)fAtom1.a_w.w_float;
-                                float value = fAtom2.a_w.w_float;
-                                component->setMixerButtonValue(index, value);
-                            } else if (subCommand.compare("fader")==0) {
-                                int index = (int)fAtom1.a_w.w_float;
-                                float value = fAtom2.a_w.w_float;
-                                component->setMixerFaderValue(index, value);
-                            }
-
-                        }
-                    }
-                    // set led color command
-                    else if (command.compare("led")==0 && argc>3) {
-                        t_atom fAtom1 = argv[1];
-                        t_atom fAtom2 = argv[2];
-                        t_atom sAtom = argv[3];
-                        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
-                            int x = (int)fAtom1.a_w.w_float;
-                            int y = fAtom2.a_w.w_float;
-                            String *hexString = new String(sAtom.a_w.w_symbol->s_name);
-                            uint32 argb = 0xff000000 + hexString->getHexValue32();
-                            LEDColour *color = new LEDColour(argb);
-                            component->setLEDColor(x - 1, y - 1, color);
-                        }
-                    }
-                    // draw rect with color command
-                    else if (command.compare("rect")==0 && argc>5) {
-                        t_atom fAtom1 = argv[1];
-                        t_atom fAtom2 = argv[2];
-                        t_atom fAtom3 = argv[3];
-                        t_atom fAtom4 = argv[4];
-                        t_atom sAtom = argv[5];
-                        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT && fAtom3.a_type==A_FLOAT && fAtom4.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
-                            int x = (int)fAtom1.a_w.w_float;
-                            int y = (int)fAtom2.a_w.w_float;
-                            int w = (int)fAtom3.a_w.w_float;
-                            int h = (int)fAtom4.a_w.w_float;
-                            String *hexString = new String(sAtom.a_w.w_symbol->s_name);
-                            uint32 argb = 0xff000000 + hexString->getHexValue32();
-                            LEDColour *color = new LEDColour(argb);
-                            component->setRectColor(x-1, y-1, w, h, color);
-                        }
-                    }
-                    // draw circle with color command
-                    else if (command.compare("circle")==0 && argc>4) {
-                        t_atom fAtom1 = argv[1];
-                        t_atom fAtom2 = argv[2];
-                        t_atom fAtom3 = argv[3];
-                        t_atom sAtom = argv[4];
-                        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT && fAtom3.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
-                            int x = (int)fAtom1.a_w.w_float;
-                            int y = (int)fAtom2.a_w.w_float;
-                            int r = (int)fAtom3.a_w.w_float;
-                            String *hexString = new String(sAtom.a_w.w_symbol->s_name);
-                            uint32 argb = 0xff000000 + hexString->getHexValue32();
-                            LEDColour *color = new LEDColour(argb);
-                            component->setCircleColor(x-1, y-1, r, color);
-                        }
-                    }
-                    // draw triangle with color command
-                    else if (command.compare("triangle")==0 && argc>5) {
-                        t_atom fAtom1 = argv[1];
-                        t_atom fAtom2 = argv[2];
-                        t_atom fAtom3 = argv[3];
-                        t_atom fAtom4 = argv[4];
-                        t_atom sAtom = argv[5];
-                        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT && fAtom3.a_type==A_FLOAT && fAtom4.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
-                            int x = (int)fAtom1.a_w.w_float;
-                            int y = (int)fAtom2.a_w.w_float;
-                            int s = (int)fAtom3.a_w.w_float;
-                            int d = (int)fAtom4.a_w.w_float;
-                            String *hexString = new String(sAtom.a_w.w_symbol->s_name);
-                            uint32 argb = 0xff000000 + hexString->getHexValue32();
-                            LEDColour *color = new LEDColour(argb);
-                            component->setTriangleColor(x-1, y-1, s, d, color);
-                        }
-                    }
-                    // draw number with color command
-                    else if (command.compare("number")==0) {
-                        if (argc>2) {
-                            t_atom fAtom1 = argv[1];
-                            t_atom sAtom = argv[2];
-                            if (fAtom1.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
-                                int n = (int)fAtom1.a_w.w_float;
-                                String *hexString = new String(sAtom.a_w.w_symbol->s_name);
-                                uint32 argb = 0xff000000 + hexString->getHexValue32();
-                                LEDColour *color = new LEDColour(argb);
-                                component->setNumberColor(n, color);
-                            }
-                        }
-                        if (argc>1) {
-                            t_atom sAtom = argv[1];
-                            if (sAtom.a_type==A_SYMBOL) {
-                                String symbol = String(sAtom.a_w.w_symbol->s_name);
-                                if (symbol.compare("hide")==0) {
-                                    component->hideNumberColor();
-                                }
-                            }
-                        }
-                    }
-                    // clear screen (drawing)
-                    else if (command.compare("clear")==0) {
-                        component->clearScreen();
-                    }
-                    // set block settings command
-                    else if (command.compare("set")==0 && argc>2) {
-                        t_atom sAtom = argv[1];
-                        t_atom fAtom1 = argv[2];
-                        String setting = String(sAtom.a_w.w_symbol->s_name);
-                        if (sAtom.a_type==A_SYMBOL) {
-                            MessageManager *messageManager = MessageManager::getInstance();
-                            cf_data data;
-                            data.component = component;
-                            data.name = setting;
-                            if (fAtom1.a_type==A_FLOAT) {
-                                // value
-                                int value = (int)fAtom1.a_w.w_float;
-                                data.value = value;
-                                // we have to call this in the messag thread
-                                messageManager->callFunctionOnMessageThread(settingValueFunction, &data);
-                            } else if (fAtom1.a_type==A_SYMBOL) {
-                                // option
-                                String option = String(fAtom1.a_w.w_symbol->s_name);
-                                data.option = option;
-                                // we have to call this in the messag thread
-                                messageManager->callFunctionOnMessageThread(settingsOptionFunction, &data);
-                            }
-                        }
+        if (target.compare("all")==0 || component->pdName->compare(target)==0) {
+            components.add(component);
+        }
+    }
+    return components;
+}
+
+void BlockFinder::doGroupCommand(int argc, t_atom *argv) {
+    if (argc<1 || argv[0].a_type!=A_SYMBOL) return;
+    String group = String(argv[0].a_w.w_symbol->s_name);
+    if (group.compare("all")==0) {
+        error("group: 'all' are all blocks");
+        return;
+    }
+    StringArray members;
+    for (int i=1; i<argc; i++) {
+        if (argv[i].a_type==A_SYMBOL) {
+            members.addIfNotAlreadyThere(String(argv[i].a_w.w_symbol->s_name));
+        }
+    }
+    // without blocks the group is removed
+    if (members.size()==0) {
+        groups.remove(group);
+    } else {
+        groups.set(group, members);
+    }
+}
+
+void BlockFinder::doComponentCommand(const Array<BlockComponent*>& components, int argc, t_atom *argv) {
+    // the arguments are parsed once for all blocks
+    String command = String(argv[0].a_w.w_symbol->s_name);
+    // set programm as default
+    if (command.compare("setdefault")==0) {
+        for (BlockComponent* component : components) {
+            component->setDefault();
+        }
+        post("setting default program");
+    }
+    // mode command
+    else if (command.compare("mode")==0 && argc>1) {
+        t_atom pAtom = argv[1];
+        int size = 2;
+        if (argc>2 && argv[2].a_type==A_FLOAT) {
+            size = jlimit(1, 5, (int)argv[2].a_w.w_float);
+        }
+        for (BlockComponent* component : components) {
+            if (pAtom.a_type==A_SYMBOL) {
+                component->setLightpadMode(String(pAtom.a_w.w_symbol->s_name));
+            }
+            if (argc<=2 || (pAtom.a_type==A_SYMBOL && argv[2].a_type==A_FLOAT)) {
+                component->setGridSize(size);
+            }
+        }
+    }
+    // color command
+    else if (command.compare("color")==0 && argc>1) {
+        // set color for pads, faders, etc.
+        OwnedArray<LEDColour> colors;
+        for (int i=1; i<argc; i++) {
+            if (argv[i].a_type==A_SYMBOL) {
+                colors.add(new LEDColour(argbForAtom(argv[i])));
+            }
+        }
+        if (colors.size()>0) {
+            for (BlockComponent* component : components) {
+                component->setColors(&colors);
+            }
+        }
+    }
+    // set fader value command
+    else if (command.compare("fader")==0 && argc>2) {
+        t_atom fAtom1 = argv[1];
+        t_atom fAtom2 = argv[2];
+        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT) {
+            int index = (int)fAtom1.a_w.w_float;
+            float value = fAtom2.a_w.w_float;
+            for (BlockComponent* component : components) {
+                component->setFaderValue(index, value);
+            }
+        }
+    }
+    // set mixer fader and button value command
+    else if (command.compare("mixer")==0 && argc>3) {
+        t_atom sAtom = argv[1];
+        t_atom fAtom1 = argv[2];
+        t_atom fAtom2 = argv[3];
+        if (sAtom.a_type==A_SYMBOL && fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT) {
+            String subCommand = String(sAtom.a_w.w_symbol->s_name);
+            int index = (int)fAtom1.a_w.w_float;
+            float value = fAtom2.a_w.w_float;
+            for (BlockComponent* component : components) {
+                if (subCommand.compare("button")==0) {
+                    component->setMixerButtonValue(index, value);
+                } else if (subCommand.compare("fader")==0) {
+                    component->setMixerFaderValue(index, value);
+                }
+            }
+        }
+    }
+    // set led color command
+    else if (command.compare("led")==0 && argc>3) {
+        t_atom fAtom1 = argv[1];
+        t_atom fAtom2 = argv[2];
+        t_atom sAtom = argv[3];
+        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
+            int x = (int)fAtom1.a_w.w_float;
+            int y = (int)fAtom2.a_w.w_float;
+            LEDColour color(argbForAtom(sAtom));
+            for (BlockComponent* component : components) {
+                component->setLEDColor(x - 1, y - 1, &color);
+            }
+        }
+    }
+    // draw rect with color command
+    else if (command.compare("rect")==0 && argc>5) {
+        t_atom fAtom1 = argv[1];
+        t_atom fAtom2 = argv[2];
+        t_atom fAtom3 = argv[3];
+        t_atom fAtom4 = argv[4];
+        t_atom sAtom = argv[5];
+        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT && fAtom3.a_type==A_FLOAT && fAtom4.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
+            int x = (int)fAtom1.a_w.w_float;
+            int y = (int)fAtom2.a_w.w_float;
+            int w = (int)fAtom3.a_w.w_float;
+            int h = (int)fAtom4.a_w.w_float;
+            LEDColour color(argbForAtom(sAtom));
+            for (BlockComponent* component : components) {
+                component->setRectColor(x-1, y-1, w, h, &color);
+            }
+        }
+    }
+    // draw circle with color command
+    else if (command.compare("circle")==0 && argc>4) {
+        t_atom fAtom1 = argv[1];
+        t_atom fAtom2 = argv[2];
+        t_atom fAtom3 = argv[3];
+        t_atom sAtom = argv[4];
+        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT && fAtom3.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
+            int x = (int)fAtom1.a_w.w_float;
+            int y = (int)fAtom2.a_w.w_float;
+            int r = (int)fAtom3.a_w.w_float;
+            LEDColour color(argbForAtom(sAtom));
+            for (BlockComponent* component : components) {
+                component->setCircleColor(x-1, y-1, r, &color);
+            }
+        }
+    }
+    // draw triangle with color command
+    else if (command.compare("triangle")==0 && argc>5) {
+        t_atom fAtom1 = argv[1];
+        t_atom fAtom2 = argv[2];
+        t_atom fAtom3 = argv[3];
+        t_atom fAtom4 = argv[4];
+        t_atom sAtom = argv[5];
+        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT && fAtom3.a_type==A_FLOAT && fAtom4.a_type==A_FLOAT && sAtom.a_type==A_SYMBOL) {
+            int x = (int)fAtom1.a_w.w_float;
+            int y = (int)fAtom2.a_w.w_float;
+            int s = (int)fAtom3.a_w.w_float;
+            int d = (int)fAtom4.a_w.w_float;
+            LEDColour color(argbForAtom(sAtom));
+            for (BlockComponent* component : components) {
+                component->setTriangleColor(x-1, y-1, s, d, &color);
+            }
+        }
+    }
+    // draw number with color command
+    else if (command.compare("number")==0) {
+        if (argc>2 && argv[1].a_type==A_FLOAT && argv[2].a_type==A_SYMBOL) {
+            int n = (int)argv[1].a_w.w_float;
+            LEDColour color(argbForAtom(argv[2]));
+            for (BlockComponent* component : components) {
+                component->setNumberColor(n, &color);
+            }
+        }
+        if (argc>1 && argv[1].a_type==A_SYMBOL && String(argv[1].a_w.w_symbol->s_name).compare("hide")==0) {
+            for (BlockComponent* component : components) {
+                component->hideNumberColor();
+            }
+        }
+    }
+    // clear screen (drawing)
+    else if (command.compare("clear")==0) {
+        for (BlockComponent* component : components) {
+            component->clearScreen();
+        }
+    }
+    // color mode rgb / indexed
+    else if (command.compare("colormode")==0 && argc>1) {
+        t_atom sAtom = argv[1];
+        if (sAtom.a_type==A_SYMBOL) {
+            String mode = String(sAtom.a_w.w_symbol->s_name);
+            for (BlockComponent* component : components) {
+                if (mode.compare("indexed")==0) {
+                    component->setColorMode(true);
+                } else if (mode.compare("rgb")==0) {
+                    component->setColorMode(false);
+                }
+            }
+        }
+    }
+    // 16 palette colors
+    else if (command.compare("palette")==0 && argc>1) {
+        OwnedArray<LEDColour> colors;
+        for (int i=1; i<argc; i++) {
+            if (argv[i].a_type==A_SYMBOL) {
+                colors.add(new LEDColour(argbForAtom(argv[i])));
+            }
+        }
+        if (colors.size()>0) {
+            for (BlockComponent* component : components) {
+                component->setPalette(&colors);
+            }
+        }
+    }
+    // palette indexes starting at x y
+    else if (command.compare("pixels")==0 && argc>3) {
+        t_atom fAtom1 = argv[1];
+        t_atom fAtom2 = argv[2];
+        if (fAtom1.a_type==A_FLOAT && fAtom2.a_type==A_FLOAT) {
+            int x = (int)fAtom1.a_w.w_float;
+            int y = (int)fAtom2.a_w.w_float;
+            Array<int> indexes;
+            for (int i=3; i<argc; i++) {
+                if (argv[i].a_type==A_FLOAT) {
+                    indexes.add((int)argv[i].a_w.w_float);
+                }
+            }
+            for (BlockComponent* component : components) {
+                if (!component->indexedColor) {
+                    error("pixels: set 'colormode indexed' first");
+                } else {
+                    component->setPixels(x - 1 + (y - 1) * 15, indexes);
+                }
+            }
+        }
+    }
+    // show the hidden buffer, when the drawing is received (all blocks together)
+    else if (command.compare("flip")==0) {
+        for (BlockComponent* component : components) {
+            if (!component->doubleBuffered) {
+                error("flip: block '%s' is not double buffered", component->pdName->toStdString().c_str());
+            }
+        }
+        commitBlocks(components);
+    }
+    // double buffering on / off
+    else if (command.compare("buffer")==0 && argc>1) {
+        t_atom fAtom = argv[1];
+        if (fAtom.a_type==A_FLOAT) {
+            for (BlockComponent* component : components) {
+                component->setDoubleBuffering(fAtom.a_w.w_float!=0);
+            }
+        }
+    }
+    // leds without echos, checked with row checksums
+    else if (command.compare("verify")==0 && argc>1) {
+        if (argv[1].a_type==A_FLOAT) {
+            for (BlockComponent* component : components) {
+                component->setDrawingVerification(argv[1].a_w.w_float!=0);
+            }
+        }
+    }
+    // a new frame replaces the waiting older ones
+    else if (command.compare("dropframes")==0 && argc>1) {
+        if (argv[1].a_type==A_FLOAT) {
+            for (BlockComponent* component : components) {
+                component->dropStaleFrames = argv[1].a_w.w_float!=0;
+            }
+        }
+    }
+    // snapshot of the state, a recall sends only the differences
+    else if (command.compare("scene")==0 && argc>2) {
+        if (argv[1].a_type==A_SYMBOL && argv[2].a_type==A_FLOAT) {
+            String action = String(argv[1].a_w.w_symbol->s_name);
+            int number = (int)argv[2].a_w.w_float;
+            for (BlockComponent* component : components) {
+                if (action.compare("store")==0) {
+                    component->storeScene(number);
+                } else if (action.compare("recall")==0) {
+                    if (!component->recallScene(number)) {
+                        error("scene: %s has no scene %i", component->pdName->toStdString().c_str(), number);
                     }
-                    else {
-                        error("no method for '%s'", command.toStdString().c_str());
+                } else {
+                    error("scene: no method for '%s'", action.toStdString().c_str());
+                    break;
+                }
+            }
+        }
+    }
+    // capture the traffic into a file / stop it
+    else if (command.compare("record")==0 && argc>1) {
+        t_atom sAtom = argv[1];
+        if (sAtom.a_type==A_SYMBOL) {
+            String path = String(sAtom.a_w.w_symbol->s_name);
+            if (path.compare("stop")==0) {
+                for (BlockComponent* component : components) {
+                    if (component->recorder!=nullptr) {
+                        int numRecords = component->recorder->getNumRecords();
+                        String fileName = component->recorder->getFile().getFullPathName();
+                        component->stopRecording();
+                        post("record: %i events in %s", numRecords, fileName.toStdString().c_str());
                     }
                 }
+            } else if (components.size()>1) {
+                error("record: one file per block");
+            } else {
+                File file = File::getCurrentWorkingDirectory().getChildFile(path);
+                if (!components.getFirst()->startRecording(file)) {
+                    error("record: can't write %s", file.getFullPathName().toStdString().c_str());
+                }
+            }
+        }
+    }
+    // messages per second to the block, 0 without a limit
+    else if (command.compare("rate")==0 && argc>1) {
+        // -1 for the rate of the connection
+        double rate = argv[1].a_type==A_FLOAT ? jmax(0.0f, argv[1].a_w.w_float) : -1;
+        for (BlockComponent* component : components) {
+            component->setMaxRate(rate);
+        }
+    }
+    else {
+        error("no method for '%s'", command.toStdString().c_str());
+    }
+}
+
+void BlockFinder::doSettingsCommand(const Array<BlockComponent*>& components, int argc, t_atom *argv) {
+    // 'preset' posts only the number of changed settings
+    String command = String(argv[0].a_w.w_symbol->s_name);
+    bool verbose = command.compare("set")==0;
+    if (argc<3) {
+        error("%s: missing setting", command.toStdString().c_str());
+        return;
+    }
+    // pairs of setting and value (or option)
+    for (int i=1; i<argc; i+=2) {
+        if (argv[i].a_type!=A_SYMBOL) continue;
+        String setting = String(argv[i].a_w.w_symbol->s_name);
+        if (i+1>=argc) {
+            error("%s: no value for %s", command.toStdString().c_str(), setting.toStdString().c_str());
+        } else {
+            for (BlockComponent* component : components) {
+                if (argv[i+1].a_type==A_FLOAT) {
+                    component->queueSettingsValue(setting, (int)argv[i+1].a_w.w_float, verbose);
+                } else if (argv[i+1].a_type==A_SYMBOL) {
+                    component->queueSettingsValue(setting, String(argv[i+1].a_w.w_symbol->s_name), verbose);
+                }
             }
         }
     }
+}
+
+FramePlayer* BlockFinder::playerForTarget(const String& target) {
+    for (FramePlayer* player : players) {
+        if (player->getTarget().compare(target)==0) return player;
+    }
+    return nullptr;
+}
+
+void BlockFinder::doPlayCommand(const String& target, const Array<BlockComponent*>& components, int argc, t_atom *argv) {
+    if (argc<2 || argv[1].a_type!=A_SYMBOL) {
+        error("play: missing file");
+        return;
+    }
+    String command = String(argv[1].a_w.w_symbol->s_name);
+    FramePlayer *player = playerForTarget(target);
+    if (command.compare("stop")==0 || command.compare("seek")==0 || command.compare("loop")==0) {
+        if (player==nullptr) {
+            error("play: '%s' is not playing", target.toStdString().c_str());
+        } else if (command.compare("stop")==0) {
+            players.removeObject(player);
+        } else if (argc>2 && argv[2].a_type==A_FLOAT) {
+            if (command.compare("seek")==0) {
+                player->seek((int)argv[2].a_w.w_float);
+            } else {
+                player->looping = argv[2].a_w.w_float!=0;
+            }
+        }
+        return;
+    }
     
-    if (!found) {
-        error("block '%s' not found", name->s_name);
+    // play [file] [fps] [loop]
+    File file = File::getCurrentWorkingDirectory().getChildFile(command);
+    bool looping = argc>3 && argv[3].a_type==A_FLOAT && argv[3].a_w.w_float!=0;
+    double fps = argc>2 && argv[2].a_type==A_FLOAT ? argv[2].a_w.w_float : 30;
+    // the same file again (e.g. after it ended) with the mapped file
+    if (player!=nullptr && player->getFile()==file && player->getComponents()==components) {
+        player->looping = looping;
+        player->start(fps);
+        return;
+    }
+    FramePlayer *newPlayer = new FramePlayer(target, file, components);
+    if (!newPlayer->isValid()) {
+        error("play: can't read frames from %s", file.getFullPathName().toStdString().c_str());
+        delete newPlayer;
+        return;
+    }
+    // a block plays one file at a time
+    for (int i = players.size(); --i >= 0;) {
+        for (BlockComponent* component : components) {
+            if (players[i]->getComponents().contains(component)) {
+                players.remove(i);
+                break;
+            }
+        }
+    }
+    newPlayer->listener = this;
+    newPlayer->looping = looping;
+    players.add(newPlayer);
+    newPlayer->start(fps);
+    post("play: %i frames of %i blocks from %s", newPlayer->getNumFrames(), newPlayer->getNumBlocks(), file.getFullPathName().toStdString().c_str());
+}
+
+void BlockFinder::frameUploaded(FramePlayer& player) {
+    // double buffered blocks show the frame together
+    Array<BlockComponent*> components;
+    for (BlockComponent* component : player.getComponents()) {
+        if (component!=nullptr && component->doubleBuffered) components.add(component);
+    }
+    if (components.size()>0) commitBlocks(components);
+}
+
+void BlockFinder::playbackFinished(FramePlayer& player) {
+    // [target] play end
+    t_atom at[2];
+    SETSYMBOL(at, gensym("play"));
+    SETSYMBOL(at + 1, gensym("end"));
+    outlet_anything(out_B, gensym(player.getTarget().toRawUTF8()), 2, at);
+}
+
+void BlockFinder::doStatsCommand(int argc, t_atom *argv) {
+    const MessageManagerLock mmLock;
+    if (argc>0 && argv[0].a_type==A_FLOAT) {
+        // every n ms, 0 stops
+        statsInterval = jmax(0.0f, argv[0].a_w.w_float);
+        lastStatsTime = Time::getMillisecondCounterHiRes();
+        return;
+    }
+    if (argc>0 && argv[0].a_type==A_SYMBOL && String(argv[0].a_w.w_symbol->s_name).compare("reset")==0) {
+        resetStats();
+        return;
+    }
+    outputStats();
+}
+
+void BlockFinder::doSubscribeCommand(int argc, t_atom *argv) {
+    if (argc<1 || argv[0].a_type!=A_FLOAT) {
+        error("subscribe: use 'subscribe [ms]' (0 stops)");
+        return;
+    }
+    const MessageManagerLock mmLock;
+    subscribeInterval = jmax(0.0f, argv[0].a_w.w_float);
+    lastSubscribeTime = Time::getMillisecondCounterHiRes();
+    // the current values first, then only the changes
+    if (subscribeInterval>0) {
+        for (BlockComponent* component : blockComponents) {
+            component->outputInfos();
+        }
+    }
+}
+
+void BlockFinder::doTraceCommand(int argc, t_atom *argv) {
+    String command = (argc>0 && argv[0].a_type==A_SYMBOL) ? String(argv[0].a_w.w_symbol->s_name) : String();
+    if (command.compare("start")==0) {
+        Tracer::start();
+    } else if (command.compare("stop")==0 && argc>1 && argv[1].a_type==A_SYMBOL) {
+        File file = File::getCurrentWorkingDirectory().getChildFile(String(argv[1].a_w.w_symbol->s_name));
+        int numEvents = Tracer::stop(file);
+        if (numEvents<0) {
+            error("trace: can't write %s", file.getFullPathName().toStdString().c_str());
+            return;
+        }
+        post("trace: %i events in %s", numEvents, file.getFullPathName().toStdString().c_str());
+        int numDropped = Tracer::getNumDropped();
+        if (numDropped>0) {
+            post("trace: %i events didn't fit into the buffers", numDropped);
+        }
+    } else {
+        error("trace: use 'trace start' or 'trace stop [file]'");
+    }
+}
+
+void BlockFinder::resetStats() {
+    numCommands.store(0, std::memory_order_relaxed);
+    dispatchLateSum.store(0, std::memory_order_relaxed);
+    dispatchLateCount.store(0, std::memory_order_relaxed);
+    dispatchLateMax.store(0, std::memory_order_relaxed);
+    for (BlockComponent* component : blockComponents) {
+        component->stats.reset();
+    }
+}
+
+void BlockFinder::outputStats() {
+    for (BlockComponent* component : blockComponents) {
+        component->outputStats();
     }
+    // stats commands [n], stats dispatch [average ms] [max ms]
+    t_atom at[3];
+    SETSYMBOL(at, gensym("commands"));
+    SETFLOAT(at + 1, (t_float)numCommands.load(std::memory_order_relaxed));
+    outlet_anything(out_B, gensym("stats"), 2, at);
+    int64 count = dispatchLateCount.load(std::memory_order_relaxed);
+    double average = count>0 ? (double)dispatchLateSum.load(std::memory_order_relaxed) / (double)count : 0;
+    SETSYMBOL(at, gensym("dispatch"));
+    SETFLOAT(at + 1, (t_float)(average / 1000.0));
+    SETFLOAT(at + 2, (t_float)((double)dispatchLateMax.load(std::memory_order_relaxed) / 1000.0));
+    outlet_anything(out_B, gensym("stats"), 3, at);
+}
+
+void BlockFinder::timerCallback() {
+    double now = Time::getMillisecondCounterHiRes();
+    if (lastTimerTime>0) {
+        int64 late = (int64)(jmax(0.0, now - lastTimerTime - getTimerInterval()) * 1000.0);
+        dispatchLateSum.fetch_add(late, std::memory_order_relaxed);
+        dispatchLateCount.fetch_add(1, std::memory_order_relaxed);
+        Tracer::instant("dispatchLate", late);
+        if (late>dispatchLateMax.load(std::memory_order_relaxed)) {
+            dispatchLateMax.store(late, std::memory_order_relaxed);
+        }
+    }
+    lastTimerTime = now;
+    
+    if (statsInterval>0 && now - lastStatsTime>=statsInterval) {
+        lastStatsTime = now;
+        outputStats();
+    }
+    
+    if (topologyChangedTime>0 && now - topologyChangedTime>=topologyDebounceMs) {
+        updateTopology();
+    }
+    
+    if (subscribeInterval>0 && now - lastSubscribeTime>=subscribeInterval) {
+        lastSubscribeTime = now;
+        for (BlockComponent* component : blockComponents) {
+            component->outputInfos(true);
+        }
+    }
+}
+
+void BlockFinder::doCanvasCommand(int argc, t_atom *argv) {
+    if (argc<1 || argv[0].a_type!=A_SYMBOL) {
+        error("canvas: missing command");
+        return;
+    }
+    String command = String(argv[0].a_w.w_symbol->s_name);
+    
+    // the canvas is also used by the touch callbacks in the message thread
+    const MessageManagerLock mmLock;
+    
+    if (command.compare("on")==0) {
+        canvas.layout(pts.getCurrentTopology(), blockComponents);
+        for (BlockComponent* component : blockComponents) {
+            if (component->canvas!=nullptr) {
+                component->setLightpadMode("paint");
+                component->setDoubleBuffering(true);
+            }
+        }
+        canvas.outputLayout(out_B);
+        return;
+    }
+    if (command.compare("off")==0) {
+        canvas.detach();
+        return;
+    }
+    if (!canvas.isActive()) {
+        error("canvas: not active, send 'canvas on' first");
+        return;
+    }
+    
+    // coordinates start at 1 like on the blocks
+    if (command.compare("led")==0 && argc>3) {
+        if (argv[1].a_type==A_FLOAT && argv[2].a_type==A_FLOAT && argv[3].a_type==A_SYMBOL) {
+            int x = (int)argv[1].a_w.w_float;
+            int y = (int)argv[2].a_w.w_float;
+            canvas.setLEDColor(x-1, y-1, argbForAtom(argv[3]));
+        }
+    }
+    else if (command.compare("rect")==0 && argc>5) {
+        if (argv[1].a_type==A_FLOAT && argv[2].a_type==A_FLOAT && argv[3].a_type==A_FLOAT && argv[4].a_type==A_FLOAT && argv[5].a_type==A_SYMBOL) {
+            int x = (int)argv[1].a_w.w_float;
+            int y = (int)argv[2].a_w.w_float;
+            int w = (int)argv[3].a_w.w_float;
+            int h = (int)argv[4].a_w.w_float;
+            canvas.setRectColor(x-1, y-1, w, h, argbForAtom(argv[5]));
+        }
+    }
+    else if (command.compare("circle")==0 && argc>4) {
+        if (argv[1].a_type==A_FLOAT && argv[2].a_type==A_FLOAT && argv[3].a_type==A_FLOAT && argv[4].a_type==A_SYMBOL) {
+            int x = (int)argv[1].a_w.w_float;
+            int y = (int)argv[2].a_w.w_float;
+            int r = (int)argv[3].a_w.w_float;
+            canvas.setCircleColor(x-1, y-1, r, argbForAtom(argv[4]));
+        }
+    }
+    else if (command.compare("clear")==0) {
+        canvas.clearScreen();
+    }
+    else if (command.compare("frame")==0) {
+        // all blocks show the new frame at the same time
+        canvas.uploadFrame();
+        commitBlocks(canvas.getComponents());
+    }
+    else if (command.compare("layout")==0) {
+        canvas.outputLayout(out_B);
+    }
+    else {
+        error("canvas: no method for '%s'", command.toStdString().c_str());
+    }
+}
+
+void BlockFinder::doCommitCommand(int argc, t_atom *argv) {
+    // the blocks can't be removed, while they are searched
+    const MessageManagerLock mmLock;
+    Array<BlockComponent*> components;
+    for (int i=0; i<argc; i++) {
+        if (argv[i].a_type!=A_SYMBOL) continue;
+        String target = String(argv[i].a_w.w_symbol->s_name);
+        Array<BlockComponent*> targetComponents = componentsForTarget(target);
+        for (BlockComponent* component : targetComponents) {
+            components.addIfNotAlreadyThere(component);
+        }
+        if (targetComponents.size()==0) {
+            error("block '%s' not found", target.toStdString().c_str());
+        }
+    }
+    if (components.size()>0) {
+        commitBlocks(components);
+    }
+}
+
+void BlockFinder::commitBlocks(const Array<BlockComponent*>& components) {
+    // only double buffered Lightpads swap
+    for (BlockComponent* component : components) {
+        if (component->doubleBuffered && !commitComponents.contains(component)) {
+            component->prepareSwap();
+            commitComponents.add(component);
+        }
+    }
+    checkCommit();
+}
+
+void BlockFinder::checkCommit() {
+    if (commitComponents.size()==0) return;
+    
+    // wait until every block has received its drawing
+    for (BlockComponent* component : commitComponents) {
+        if (component->numDrawingMessages()>0) return;
+    }
+    // and swap them all together
+    const MessageManagerLock mmLock;
+    for (BlockComponent* component : commitComponents) {
+        component->swapBuffers();
+    }
+    commitComponents.clear();
+}
+
+void BlockFinder::drawingAcknowledged(BlockComponent& component) {
+    if (commitComponents.contains(&component)) {
+        checkCommit();
+    }
+}
+
+void BlockFinder::addComponent(BlockComponent *component) {
+    const MessageManagerLock mmLock;
+    component->out_action = out_A;
+    component->out_info = out_B;
+    component->listener = this;
+    const ScopedLock lock(componentsLock);
+    blockComponents.add(component);
 }
 
 void BlockFinder::pollInfos() {
+    const MessageManagerLock mmLock;
     for (BlockComponent* component : blockComponents) {
         component->outputInfos();
     }
@@ -332,6 +900,7 @@ void BlockFinder::updateComponents() {
     const MessageManagerLock *mmLock = new MessageManagerLock();
 
     for (BlockComponent* component : blockComponents) {
+        if (component->block==nullptr) continue;
         String name = serialsAndNames->getValue(String(component->block->serialNumber), String());
         if (name.length()>0) {
             component->pdName = new String(name);
@@ -341,54 +910,75 @@ void BlockFinder::updateComponents() {
     mmLock = nullptr;
 }
 
-void BlockFinder::outputTopology() {
-    auto currentTopology = pts.getCurrentTopology();
-
-    for (BlockComponent* component : blockComponents) {
-        t_symbol *name = gensym(component->pdName->toStdString().c_str());
-        t_atom at[3];
+static String edgeName(Block::ConnectionPort::DeviceEdge edge) {
+    switch (edge) {
+        case juce::Block::ConnectionPort::DeviceEdge::north:
+            return String("north");
+        case juce::Block::ConnectionPort::DeviceEdge::east:
+            return String("east");
+        case juce::Block::ConnectionPort::DeviceEdge::south:
+            return String("south");
+        case juce::Block::ConnectionPort::DeviceEdge::west:
+            return String("west");
+        default:
+            return String();
+    }
+}
 
-        Block::Array connectedBlocks = currentTopology.getDirectlyConnectedBlocks(component->block->uid);
-        for (auto& connectedBlock : connectedBlocks) {
-            
-            String blockName = String();
-            for (BlockComponent* component : blockComponents) {
-                if (component->block->uid==connectedBlock->uid) {
-                    blockName = *component->pdName;
-                }
-            }
-            
-            Array<BlockDeviceConnection> connections = currentTopology.getConnectionsBetweenBlocks(component->block->uid, connectedBlock->uid);
-            for (auto& connection : connections) {
-                Block::ConnectionPort port;
-                if (connection.device1==component->block->uid) {
-                    port = connection.connectionPortOnDevice1;
-                } else {
-                    port = connection.connectionPortOnDevice2;
-                }
-                String edge = String();
-                switch (port.edge) {
-                    case juce::Block::ConnectionPort::DeviceEdge::north:
-                        edge = String("north");
-                        break;
-                    case juce::Block::ConnectionPort::DeviceEdge::east:
-                        edge = String("east");
-                        break;
-                    case juce::Block::ConnectionPort::DeviceEdge::south:
-                        edge = String("south");
-                        break;
-                    case juce::Block::ConnectionPort::DeviceEdge::west:
-                        edge = String("west");
-                        break;
-                    default:
-                        break;
-                }
-                SETSYMBOL(at, gensym(edge.toStdString().c_str()));
-                SETFLOAT(at + 1, (t_float)static_cast<float>(port.index));
-                SETSYMBOL(at + 2, gensym(blockName.toStdString().c_str()));
-                outlet_anything(out_C, name, 3, at);
-            }
+void BlockFinder::outputTopologyChanges(const BlockTopology& topology) {
+    // both ends of each connection
+    HashMap<String, TopologyLink> links;
+    for (auto& connection : topology.connections) {
+        for (int end = 0; end < 2; end++) {
+            TopologyLink link;
+            link.uid = (int64)(end==0 ? connection.device1 : connection.device2);
+            link.otherUid = (int64)(end==0 ? connection.device2 : connection.device1);
+            const Block::ConnectionPort& port = end==0 ? connection.connectionPortOnDevice1 : connection.connectionPortOnDevice2;
+            link.edge = edgeName(port.edge);
+            link.index = (int)port.index;
+            links.set(String(link.uid) + " " + link.edge + " " + String(link.index) + " " + String(link.otherUid), link);
         }
     }
+    
+    // [name] disconnected|connected [edge] [index] [other name]
+    t_atom at[4];
+    for (HashMap<String, TopologyLink>::Iterator i(topologyLinks); i.next();) {
+        if (links.contains(i.getKey())) continue;
+        const TopologyLink& link = i.getValue();
+        SETSYMBOL(at, gensym("disconnected"));
+        SETSYMBOL(at + 1, gensym(link.edge.toStdString().c_str()));
+        SETFLOAT(at + 2, (t_float)link.index);
+        SETSYMBOL(at + 3, gensym(topologyNames[link.otherUid].toStdString().c_str()));
+        outlet_anything(out_C, gensym(topologyNames[link.uid].toStdString().c_str()), 4, at);
+    }
+    
+    // names of the current blocks, [name] removed|added
+    HashMap<int64, String> names;
+    for (BlockComponent* component : blockComponents) {
+        if (component->block==nullptr) continue;
+        names.set((int64)component->block->uid, *component->pdName);
+    }
+    for (HashMap<int64, String>::Iterator i(topologyNames); i.next();) {
+        if (names.contains(i.getKey())) continue;
+        SETSYMBOL(at, gensym("removed"));
+        outlet_anything(out_C, gensym(i.getValue().toStdString().c_str()), 1, at);
+    }
+    for (HashMap<int64, String>::Iterator i(names); i.next();) {
+        if (topologyNames.contains(i.getKey())) continue;
+        SETSYMBOL(at, gensym("added"));
+        outlet_anything(out_C, gensym(i.getValue().toStdString().c_str()), 1, at);
+    }
+    
+    for (HashMap<String, TopologyLink>::Iterator i(links); i.next();) {
+        if (topologyLinks.contains(i.getKey())) continue;
+        const TopologyLink& link = i.getValue();
+        SETSYMBOL(at, gensym("connected"));
+        SETSYMBOL(at + 1, gensym(link.edge.toStdString().c_str()));
+        SETFLOAT(at + 2, (t_float)link.index);
+        SETSYMBOL(at + 3, gensym(names[link.otherUid].toStdString().c_str()));
+        outlet_anything(out_C, gensym(names[link.uid].toStdString().c_str()), 4, at);
+    }
+    
+    topologyLinks.swapWith(links);
+    topologyNames.swapWith(names);
 }
-
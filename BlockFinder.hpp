@@ -18,11 +18,17 @@
 
 #include <BlocksHeader.h>
 #include "BlockComponent.hpp"
+#include "BlockCanvas.hpp"
+#include "FramePlayer.hpp"
 #include "m_pd.h"
+#include <atomic>
 
 // Monitors a PhysicalTopologySource for changes to the connected BLOCKS and
 // prints some information about the BLOCKS that are available.
-class BlockFinder : private juce::TopologySource::Listener
+class BlockFinder : private juce::TopologySource::Listener,
+                    private BlockComponent::Listener,
+                    private FramePlayer::Listener,
+                    private juce::Timer
 {
 public:
     // Register as a listener to the PhysicalTopologySource, so that we receive
@@ -40,6 +46,9 @@ public:
     void doBlockCommand(t_symbol *name, int argc, t_atom *argv);
     void pollInfos();
     
+    // Lightpad without a block (e.g. the emulator), the finder owns it
+    void addComponent(BlockComponent *component);
+    
         
 private:
     // Called by the PhysicalTopologySource when the BLOCKS topology changes.
@@ -50,11 +59,90 @@ private:
         
     juce::StringPairArray* serialsAndNames = nullptr;
     
-    // new for multiple Blocks
+    // new for multiple Blocks, added and removed in the message thread. The
+    // settings are queued without it and only hold componentsLock
     juce::OwnedArray<BlockComponent> blockComponents;
+    juce::CriticalSection componentsLock;
+    
+    // all Lightpads as one drawing surface
+    BlockCanvas canvas;
 
+    // changes of the topology are applied after topologyDebounceMs without
+    // a further change, e.g. while a chain of blocks is assembled (0 = none pending)
+    double topologyChangedTime;
+    static const int topologyDebounceMs = 250;
+    
+    // state of the disconnected Lightpads by serial number
+    juce::HashMap<juce::String, BlockComponent::RetainedState> retainedStates;
+    juce::HashMap<juce::String, juce::Array<BlockComponent::Scene>> retainedScenes;
+    
+    // blocks by uid
+    juce::HashMap<juce::int64, BlockComponent*> componentsByUid;
+    
+    // connections at the last output by "uid edge index otherUid",
+    // with the names of the blocks at that time
+    struct TopologyLink
+    {
+        juce::int64 uid;
+        juce::String edge;
+        int index;
+        juce::int64 otherUid;
+    };
+    juce::HashMap<juce::String, TopologyLink> topologyLinks;
+    juce::HashMap<juce::int64, juce::String> topologyNames;
+    
+    void updateTopology();
     void updateComponents();
-    void outputTopology();
+    void outputTopologyChanges(const juce::BlockTopology& topology);
+    void doCanvasCommand(int argc, t_atom *argv);
+    
+    // block names by group name, a command to a group (or 'all') is parsed once
+    juce::HashMap<juce::String, juce::StringArray> groups;
+    juce::Array<BlockComponent*> componentsForTarget(const juce::String& target);
+    void doGroupCommand(int argc, t_atom *argv);
+    void doComponentCommand(const juce::Array<BlockComponent*>& components, int argc, t_atom *argv);
+    void doSettingsCommand(const juce::Array<BlockComponent*>& components, int argc, t_atom *argv);
+    
+    // image sequences by target (a block, a group or all)
+    juce::OwnedArray<FramePlayer> players;
+    FramePlayer* playerForTarget(const juce::String& target);
+    void doPlayCommand(const juce::String& target, const juce::Array<BlockComponent*>& components, int argc, t_atom *argv);
+    
+    // blocks waiting for the drawing, before swapping the buffers together
+    juce::Array<BlockComponent*> commitComponents;
+    
+    void commitBlocks(const juce::Array<BlockComponent*>& components);
+    void doCommitCommand(int argc, t_atom *argv);
+    void checkCommit();
+    
+    // stats of all blocks, once or every statsInterval ms
+    std::atomic<juce::int64> numCommands;
+    double statsInterval;
+    double lastStatsTime;
+    
+    // how late the timer is called, as the latency of the dispatch loop (in us)
+    double lastTimerTime;
+    std::atomic<juce::int64> dispatchLateSum;
+    std::atomic<juce::int64> dispatchLateCount;
+    std::atomic<juce::int64> dispatchLateMax;
+    
+    // infos of all blocks every subscribeInterval ms, only the changed ones
+    double subscribeInterval;
+    double lastSubscribeTime;
+    
+    void doStatsCommand(int argc, t_atom *argv);
+    void doSubscribeCommand(int argc, t_atom *argv);
+    void doTraceCommand(int argc, t_atom *argv);
+    void outputStats();
+    void resetStats();
+    void timerCallback() override;
+    
+    /** Overridden from BlockComponent::Listener */
+    void drawingAcknowledged(BlockComponent& component) override;
+    
+    /** Overridden from FramePlayer::Listener */
+    void frameUploaded(FramePlayer& player) override;
+    void playbackFinished(FramePlayer& player) override;
     
     JUCE_LEAK_DETECTOR (BlockFinder)
     
@@ -0,0 +1,55 @@
+//
+//  BlockStats.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "BlockStats.hpp"
+
+using namespace juce;
+
+BlockStats::BlockStats() {
+    // gauges of the queues, which are not reset
+    for (auto& queued : laneQueued) {
+        queued.store(0, std::memory_order_relaxed);
+    }
+    reset();
+}
+
+void BlockStats::reset() {
+    messagesSent.store(0, std::memory_order_relaxed);
+    bytesSent.store(0, std::memory_order_relaxed);
+    acksReceived.store(0, std::memory_order_relaxed);
+    unknownAcks.store(0, std::memory_order_relaxed);
+    staleAcks.store(0, std::memory_order_relaxed);
+    coalesced.store(0, std::memory_order_relaxed);
+    retransmissions.store(0, std::memory_order_relaxed);
+    stalls.store(0, std::memory_order_relaxed);
+    framesSubmitted.store(0, std::memory_order_relaxed);
+    framesDropped.store(0, std::memory_order_relaxed);
+    checksumRequests.store(0, std::memory_order_relaxed);
+    rowsRepaired.store(0, std::memory_order_relaxed);
+    touchesReceived.store(0, std::memory_order_relaxed);
+    touchesDelivered.store(0, std::memory_order_relaxed);
+    pdWaiting.store(0, std::memory_order_relaxed);
+    pdWaitingMax.store(0, std::memory_order_relaxed);
+    resendDue.store(0, std::memory_order_relaxed);
+    ackLatency.reset();
+    touchLatency.reset();
+    for (int i = 0; i < numLanes; i++) {
+        laneMessages[i].store(0, std::memory_order_relaxed);
+        laneWait[i].reset();
+    }
+}
+
+void BlockStats::enterWaiting() {
+    int waiting = pdWaiting.fetch_add(1, std::memory_order_relaxed) + 1;
+    int maximum = pdWaitingMax.load(std::memory_order_relaxed);
+    while (waiting>maximum && !pdWaitingMax.compare_exchange_weak(maximum, waiting, std::memory_order_relaxed)) {
+    }
+}
+
+void BlockStats::exitWaiting() {
+    pdWaiting.fetch_sub(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,71 @@
+//
+//  BlockStats.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+#include <atomic>
+#include "LatencyHistogram.hpp"
+
+// priority lanes of the outgoing messages, in the order they are sent
+enum MessageLane
+{
+    controlLane,    // mode, colours, faders, overlay
+    resendLane,     // messages without an echo
+    drawingLane,    // leds, palette and buffers, limited by the messages in flight
+    numLanes
+};
+
+// Counters of the message handling of one block. They are updated by the Pd
+// thread and the message thread on every message, so they are relaxed atomics
+// and a snapshot can be slightly inconsistent between counters.
+class BlockStats
+{
+public:
+    BlockStats();
+
+    std::atomic<juce::int64> messagesSent;
+    std::atomic<juce::int64> bytesSent;         // payload of the program messages
+    std::atomic<juce::int64> acksReceived;
+    std::atomic<juce::int64> unknownAcks;       // echo without a message waiting for it
+    std::atomic<juce::int64> staleAcks;         // echo of a replaced or resent message
+    std::atomic<juce::int64> coalesced;         // waiting messages replaced by a newer value
+    std::atomic<juce::int64> retransmissions;
+    std::atomic<juce::int64> stalls;            // link without echos, see LinkHealth
+    std::atomic<juce::int64> framesSubmitted;   // whole frames, e.g. canvas frame
+    std::atomic<juce::int64> framesDropped;     // frames replaced before they were sent
+    std::atomic<juce::int64> checksumRequests;  // row checks of the verified drawing
+    std::atomic<juce::int64> rowsRepaired;      // rows sent again after a checksum mismatch
+    std::atomic<juce::int64> touchesReceived;
+    std::atomic<juce::int64> touchesDelivered;  // sent to an outlet or the canvas
+
+    // Pd calls waiting for the message thread, now and at most
+    std::atomic<int> pdWaiting;
+    std::atomic<int> pdWaitingMax;
+    // messages due for a resend at the last timer scan
+    std::atomic<int> resendDue;
+
+    static void add(std::atomic<juce::int64>& counter, juce::int64 n = 1) {
+        counter.fetch_add(n, std::memory_order_relaxed);
+    }
+    void enterWaiting();
+    void exitWaiting();
+
+    // from sending a message to its echo
+    LatencyHistogram ackLatency;
+    // from the touch on the block to the outlet
+    LatencyHistogram touchLatency;
+    
+    // sent and waiting messages of each lane, from queueing to sending
+    std::atomic<juce::int64> laneMessages[numLanes];
+    std::atomic<int> laneQueued[numLanes];
+    LatencyHistogram laneWait[numLanes];
+
+    void reset();
+
+    JUCE_DECLARE_NON_COPYABLE (BlockStats)
+};
@@ -0,0 +1,226 @@
+//
+//  FrameEncoder.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "FrameEncoder.hpp"
+
+using namespace juce;
+
+void FrameEncoder::encode(const LedFrame& current, const LedFrame& target, Array<LightpadCommand>& commands, Encoding encoding) {
+    switch (encoding) {
+        case pixelEncoding:
+            encodePixels(current, target, commands);
+            return;
+        case runEncoding:
+            encodeRuns(current, target, commands, false);
+            return;
+        case frameEncoding:
+            encodeRuns(current, target, commands, true);
+            return;
+        default:
+            break;
+    }
+
+    Array<LightpadCommand> pixelCommands;
+    Array<LightpadCommand> runCommands;
+    Array<LightpadCommand> frameCommands;
+    encodePixels(current, target, pixelCommands);
+    encodeRuns(current, target, runCommands, false);
+    encodeRuns(current, target, frameCommands, true);
+
+    const Array<LightpadCommand> *shortest = &pixelCommands;
+    if (runCommands.size()<shortest->size()) shortest = &runCommands;
+    if (frameCommands.size()<shortest->size()) shortest = &frameCommands;
+    commands.addArray(*shortest);
+}
+
+LightpadCommand FrameEncoder::packPixels(const LedFrame& frame, int ledNr) {
+    LightpadCommand command = {14, (uint32)ledNr, 0, 0, 0};
+    for (int i = 0; i < 18; i++) {
+        uint32 index = frame.getLED(ledNr + i) & 0x0f;
+        if (i < 2) {
+            command.param1 |= (uint8)(index << (i * 4));
+        } else if (i < 10) {
+            command.param2 |= index << ((i - 2) * 4);
+        } else {
+            command.param3 |= index << ((i - 10) * 4);
+        }
+    }
+    return command;
+}
+
+void FrameEncoder::apply(const LightpadCommand& command, LedFrame& frame) {
+    int ledNr = (int)command.subCommandNr;
+    uint32 param1 = command.param1;
+    uint32 param2 = command.param2;
+    uint32 param3 = command.param3;
+    switch (command.commandNr) {
+        case 4:
+            frame.drawLED(ledNr, param3);
+            break;
+        case 5:
+            frame.clear();
+            break;
+        case 6:
+            frame.drawRect(ledNr, (int)param1, (int)param2, param3);
+            break;
+        case 7:
+            frame.drawCircle(ledNr, (int)param1, (int)param2, param3);
+            break;
+        case 8:
+            frame.drawTriangle(ledNr, (int)param1, (int)((param2 >> 16) & 0xff), (int)(param2 & 0xff), param3);
+            break;
+        case 13:
+            // the color mode clears the leds, if it changes
+            if (ledNr==0 && frame.isIndexed()!=(param3!=0)) frame.setIndexed(param3!=0);
+            break;
+        case 14:
+            if (!frame.isIndexed()) break;
+            for (int i = 0; i < 18; i++) {
+                uint32 index = param1 >> (i * 4);
+                if (i >= 10) index = param3 >> ((i - 10) * 4);
+                else if (i >= 2) index = param2 >> ((i - 2) * 4);
+                frame.drawLED(ledNr + i, index & 0x0f);
+            }
+            break;
+        case 15:
+            if (frame.isIndexed()) {
+                for (int i = 0; i < 9; i++) {
+                    uint32 run = param1;
+                    if (i >= 5) run = param3 >> ((i - 5) * 8);
+                    else if (i >= 1) run = param2 >> ((i - 1) * 8);
+                    int length = (run >> 4) & 0x0f;
+                    frame.drawRect(ledNr, length, 1, run & 0x0f);
+                    ledNr += length;
+                }
+            } else {
+                int length = param1 & 0xff;
+                frame.drawRect(ledNr, length, 1, param3);
+                frame.drawRect(ledNr + length, (param2 >> 24) & 0xff, 1, param2);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+const char* FrameEncoder::getName(Encoding encoding) {
+    switch (encoding) {
+        case pixelEncoding:
+            return "pixels";
+        case runEncoding:
+            return "runs";
+        case frameEncoding:
+            return "frame";
+        default:
+            break;
+    }
+    return "auto";
+}
+
+void FrameEncoder::encodePixels(const LedFrame& current, const LedFrame& target, Array<LightpadCommand>& commands) {
+    if (target.isIndexed()) {
+        // the changed led and the 17 following ones in one message
+        for (int i = 0; i < 225; i++) {
+            if (current.getLED(i)!=target.getLED(i)) {
+                commands.add(packPixels(target, i));
+                i += 17;
+            }
+        }
+        return;
+    }
+
+    int numChanged = 0;
+    int numColoured = 0;
+    for (int i = 0; i < 225; i++) {
+        if (target.getLED(i)!=current.getLED(i)) numChanged++;
+        if (target.getLED(i)!=0) numColoured++;
+    }
+    // clearing first is cheaper, if most of the changes are black leds
+    bool cleared = numColoured + 1 < numChanged;
+    if (cleared) {
+        commands.add({5, 0, 0, 0, 0});
+    }
+    for (int i = 0; i < 225; i++) {
+        uint32 colour = target.getLED(i);
+        uint32 before = cleared ? 0 : current.getLED(i);
+        if (colour!=before) {
+            commands.add({4, (uint32)i, 0, 0, 0xff000000 + colour});
+        }
+    }
+}
+
+void FrameEncoder::encodeRuns(const LedFrame& current, const LedFrame& target, Array<LightpadCommand>& commands, bool wholeFrame) {
+    if (wholeFrame) {
+        addRuns(target, 0, 225, commands);
+        return;
+    }
+
+    int ledNr = 0;
+    while (ledNr < 225) {
+        if (current.getLED(ledNr)==target.getLED(ledNr)) {
+            ledNr++;
+            continue;
+        }
+        // span of changed leds, short gaps of unchanged leds are included
+        int end = ledNr + 1;
+        int gap = 0;
+        for (int i = end; i < 225 && gap <= 3; i++) {
+            if (current.getLED(i)!=target.getLED(i)) {
+                end = i + 1;
+                gap = 0;
+            } else {
+                gap++;
+            }
+        }
+        addRuns(target, ledNr, end, commands);
+        ledNr = end;
+    }
+}
+
+void FrameEncoder::addRuns(const LedFrame& target, int start, int end, Array<LightpadCommand>& commands) {
+    // rgb: 2 runs per message, palette: 9 runs of 4 bit length and index
+    bool indexed = target.isIndexed();
+    int maxLength = indexed ? 15 : 255;
+    int runsPerMessage = indexed ? 9 : 2;
+
+    LightpadCommand command = {15, (uint32)start, 0, 0, 0};
+    int numRuns = 0;
+    int ledNr = start;
+    while (ledNr < end) {
+        uint32 colour = target.getLED(ledNr);
+        int length = 1;
+        while (ledNr + length < end && length < maxLength && target.getLED(ledNr + length)==colour) {
+            length++;
+        }
+
+        if (numRuns==runsPerMessage) {
+            commands.add(command);
+            command = {15, (uint32)ledNr, 0, 0, 0};
+            numRuns = 0;
+        }
+        if (indexed) {
+            uint32 run = ((uint32)length << 4) | (colour & 0x0f);
+            if (numRuns==0) {
+                command.param1 = (uint8)run;
+            } else if (numRuns < 5) {
+                command.param2 |= run << ((numRuns - 1) * 8);
+            } else {
+                command.param3 |= run << ((numRuns - 5) * 8);
+            }
+        } else if (numRuns==0) {
+            command.param1 = (uint8)length;
+            command.param3 = 0xff000000 + colour;
+        } else {
+            command.param2 = ((uint32)length << 24) + colour;
+        }
+        numRuns++;
+        ledNr += length;
+    }
+    if (numRuns>0) {
+        commands.add(command);
+    }
+}
@@ -0,0 +1,43 @@
+//
+//  FrameEncoder.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+#include "LedFrame.hpp"
+#include "LightpadProgram.hpp"
+
+// Turns the difference between two 15 x 15 led stores into commands for the
+// LittleFoot program. Frames with palette indexes are encoded with the packed
+// commands.
+class FrameEncoder
+{
+public:
+    enum Encoding
+    {
+        pixelEncoding,  // every changed led (18 packed leds with the palette)
+        runEncoding,    // runs of the same color over the changed leds
+        frameEncoding,  // runs of the same color over the whole frame
+        autoEncoding    // the one with the fewest messages
+    };
+
+    // adds the commands, which change the led store from current to target
+    static void encode(const LedFrame& current, const LedFrame& target, juce::Array<LightpadCommand>& commands, Encoding encoding = autoEncoding);
+
+    // 18 palette indexes starting at led ledNr in one message
+    static LightpadCommand packPixels(const LedFrame& frame, int ledNr);
+
+    // changes the led store like the program does for a drawing command
+    static void apply(const LightpadCommand& command, LedFrame& frame);
+
+    static const char* getName(Encoding encoding);
+
+private:
+    static void encodePixels(const LedFrame& current, const LedFrame& target, juce::Array<LightpadCommand>& commands);
+    static void encodeRuns(const LedFrame& current, const LedFrame& target, juce::Array<LightpadCommand>& commands, bool wholeFrame);
+    static void addRuns(const LedFrame& target, int start, int end, juce::Array<LightpadCommand>& commands);
+};
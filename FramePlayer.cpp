@@ -0,0 +1,162 @@
+//
+//  FramePlayer.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "FramePlayer.hpp"
+#include "BlockComponent.hpp"
+#include <cstring>
+
+using namespace juce;
+
+const char* FramePlayer::magic = "LPFR";
+
+FramePlayer::FramePlayer(const String& targetName, const File& file, const Array<BlockComponent*>& targetComponents)
+    : mappedFile(file, MemoryMappedFile::readOnly)
+{
+    frameFile = file;
+    target = targetName;
+    components = targetComponents;
+    looping = false;
+    listener = nullptr;
+    framesShown = 0;
+    framesSkipped = 0;
+    valid = false;
+    numFrames = 0;
+    numBlocks = 1;
+    encoding = rgbEncoding;
+    dataOffset = 0;
+    fps = 30;
+    startTime = 0;
+    startFrame = 0;
+    position = -1;
+
+    const uint8 *data = (const uint8 *)mappedFile.getData();
+    int64 size = (int64)mappedFile.getSize();
+    if (data==nullptr) return;
+    if (size>=headerSize && memcmp(data, magic, 4)==0) {
+        if (data[4]!=1 || data[5]==0 || data[6]>runEncoding) return;
+        numBlocks = data[5];
+        encoding = (Encoding)data[6];
+        dataOffset = headerSize;
+    }
+    if (encoding==runEncoding) {
+        valid = indexRuns(data + dataOffset, size - dataOffset);
+    } else {
+        numFrames = (int)((size - dataOffset) / (675 * numBlocks));
+        valid = numFrames>0;
+    }
+}
+
+FramePlayer::~FramePlayer() {
+    stopTimer();
+}
+
+bool FramePlayer::indexRuns(const uint8 *data, int64 size) {
+    // the runs have no fixed size, the start of each image is read once
+    int64 offset = 0;
+    while (offset<size) {
+        imageOffsets.add(offset);
+        int ledNr = 0;
+        while (ledNr<225) {
+            if (offset + 4>size || data[offset]==0) return false;
+            ledNr += data[offset];
+            offset += 4;
+        }
+        if (ledNr>225) return false;
+    }
+    // only whole frames
+    numFrames = imageOffsets.size() / numBlocks;
+    return numFrames>0;
+}
+
+void FramePlayer::readFrame(int frame, int block, LedFrame& ledFrame) const {
+    const uint8 *data = (const uint8 *)mappedFile.getData() + dataOffset;
+    int image = frame * numBlocks + block;
+    if (encoding==runEncoding) {
+        const uint8 *run = data + imageOffsets[image];
+        int ledNr = 0;
+        while (ledNr<225) {
+            uint32 colour = ((uint32)run[1] << 16) + ((uint32)run[2] << 8) + run[3];
+            for (int i = 0; i < run[0]; i++) {
+                ledFrame.drawLED(ledNr + i, colour);
+            }
+            ledNr += run[0];
+            run += 4;
+        }
+        return;
+    }
+    const uint8 *rgb = data + (int64)image * 675;
+    for (int i = 0; i < 225; i++) {
+        ledFrame.drawLED(i, ((uint32)rgb[i * 3] << 16) + ((uint32)rgb[i * 3 + 1] << 8) + rgb[i * 3 + 2]);
+    }
+}
+
+void FramePlayer::removeComponent(BlockComponent *component) {
+    int index = components.indexOf(component);
+    if (index>=0) components.set(index, nullptr);
+}
+
+bool FramePlayer::hasComponents() const {
+    for (BlockComponent* component : components) {
+        if (component!=nullptr) return true;
+    }
+    return false;
+}
+
+void FramePlayer::start(double framesPerSecond) {
+    fps = jlimit(0.1, 1000.0, framesPerSecond);
+    // a few checks per frame, so a frame isn't much late
+    startTimer(jmax(1, roundToInt(250.0 / fps)));
+    seek(0);
+}
+
+void FramePlayer::stop() {
+    stopTimer();
+}
+
+void FramePlayer::seek(int frame) {
+    startFrame = jlimit(0, numFrames - 1, frame);
+    startTime = Time::getMillisecondCounterHiRes();
+    position = -1;
+    // plays on from there, also after the end
+    if (!isTimerRunning()) startTimer(jmax(1, roundToInt(250.0 / fps)));
+    timerCallback();
+}
+
+void FramePlayer::timerCallback() {
+    double elapsed = Time::getMillisecondCounterHiRes() - startTime;
+    int64 due = (int64)(elapsed * fps / 1000.0);
+    if (due==position) return;
+    int64 frame = startFrame + due;
+    if (frame>=numFrames && !looping) {
+        // the last frame, if it was late
+        int64 last = numFrames - 1 - startFrame;
+        if (position<last) {
+            if (position>=0) framesSkipped += (int)(last - position - 1);
+            showFrame(numFrames - 1);
+        }
+        position = due;
+        stopTimer();
+        if (listener!=nullptr) listener->playbackFinished(*this);
+        return;
+    }
+    // the frames between the last shown and the due one are skipped
+    if (position>=0) framesSkipped += (int)(due - position - 1);
+    position = due;
+    showFrame((int)(frame % numFrames));
+}
+
+void FramePlayer::showFrame(int frame) {
+    LedFrame ledFrame;
+    for (int i = 0; i < components.size(); i++) {
+        BlockComponent *component = components[i];
+        if (component==nullptr) continue;
+        readFrame(frame, i % numBlocks, ledFrame);
+        component->uploadFrame(ledFrame);
+    }
+    framesShown++;
+    if (listener!=nullptr) listener->frameUploaded(*this);
+}
@@ -0,0 +1,99 @@
+//
+//  FramePlayer.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+#include "LedFrame.hpp"
+
+class BlockComponent;
+
+// Plays an image sequence from a memory mapped file on one or more Lightpads.
+// The frames are scheduled by the timer on the message thread, a frame which
+// is already late is skipped. Each block gets only the leds which differ from
+// its copy of the leds.
+//
+// File format: frames of 225 x 3 bytes r g b without a header, or a header
+// "LPFR" [version 1] [blocks] [encoding] [0] and then per frame one image per
+// block. Encoding 0 is r g b, 1 runs of [length 1-255] [r] [g] [b] up to 225 leds.
+class FramePlayer : private juce::Timer
+{
+public:
+    class Listener
+    {
+    public:
+        virtual ~Listener() {}
+        // all blocks got the leds of a frame
+        virtual void frameUploaded(FramePlayer& player) = 0;
+        // the last frame was shown and the player doesn't loop
+        virtual void playbackFinished(FramePlayer& player) = 0;
+    };
+
+    // image k of a frame goes to the block k (modulo the images per frame)
+    FramePlayer (const juce::String& targetName, const juce::File& file, const juce::Array<BlockComponent*>& targetComponents);
+    ~FramePlayer();
+
+    static const char* magic;
+    static const int headerSize = 8;
+    enum Encoding
+    {
+        rgbEncoding = 0,
+        runEncoding = 1
+    };
+
+    bool isValid() const { return valid; }
+    int getNumFrames() const { return numFrames; }
+    int getNumBlocks() const { return numBlocks; }
+    const juce::String& getTarget() const { return target; }
+    const juce::File& getFile() const { return frameFile; }
+    const juce::Array<BlockComponent*>& getComponents() const { return components; }
+
+    // a removed block keeps its place, the other blocks get the same images
+    void removeComponent(BlockComponent *component);
+    bool hasComponents() const;
+
+    void start(double framesPerSecond);
+    void stop();
+    bool isPlaying() const { return isTimerRunning(); }
+    // the frame is shown right away and the timing starts from it, a finished
+    // player plays again
+    void seek(int frame);
+    bool looping;
+
+    void readFrame(int frame, int block, LedFrame& ledFrame) const;
+
+    Listener *listener;
+
+    // frames sent to the blocks and frames which were late
+    int framesShown;
+    int framesSkipped;
+
+private:
+    void timerCallback() override;
+    void showFrame(int frame);
+    bool indexRuns(const juce::uint8 *data, juce::int64 size);
+
+    juce::MemoryMappedFile mappedFile;
+    juce::File frameFile;
+    juce::String target;
+    juce::Array<BlockComponent*> components;
+    bool valid;
+    int numFrames;
+    int numBlocks;
+    Encoding encoding;
+    juce::int64 dataOffset;
+    // start of each image with runs, frame * numBlocks + block
+    juce::Array<juce::int64> imageOffsets;
+
+    double fps;
+    double startTime;
+    int startFrame;
+    // frames since the start, the last shown one
+    juce::int64 position;
+
+    JUCE_LEAK_DETECTOR (FramePlayer)
+};
@@ -0,0 +1,95 @@
+//
+//  LatencyHistogram.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "LatencyHistogram.hpp"
+#include <cmath>
+#include <limits>
+
+using namespace juce;
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+int LatencyHistogram::getBucket(int64 us) {
+    if (us<32) return (int)jmax((int64)0, us);
+    int highestBit = 5;
+    while ((us >> (highestBit + 1))!=0) highestBit++;
+    // the 5 highest bits select the bucket
+    int shift = highestBit - 4;
+    int bucket = 32 + (shift - 1) * 16 + (int)((us >> shift) - 16);
+    return jmin(bucket, numBuckets - 1);
+}
+
+int64 LatencyHistogram::getBucketStart(int bucket) {
+    if (bucket<32) return bucket;
+    int shift = (bucket - 32) / 16 + 1;
+    int64 subBucket = (bucket - 32) % 16 + 16;
+    return subBucket << shift;
+}
+
+int64 LatencyHistogram::getBucketEnd(int bucket) {
+    if (bucket<32) return bucket;
+    int shift = (bucket - 32) / 16 + 1;
+    int64 subBucket = (bucket - 32) % 16 + 16;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::add(int64 us) {
+    us = jmax((int64)0, us);
+    buckets[getBucket(us)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(us, std::memory_order_relaxed);
+    int64 current = minimum.load(std::memory_order_relaxed);
+    while (us<current && !minimum.compare_exchange_weak(current, us, std::memory_order_relaxed)) {
+    }
+    current = maximum.load(std::memory_order_relaxed);
+    while (us>current && !maximum.compare_exchange_weak(current, us, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    minimum.store(std::numeric_limits<int64>::max(), std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+int64 LatencyHistogram::getCount() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+int64 LatencyHistogram::getMin() const {
+    return getCount()>0 ? minimum.load(std::memory_order_relaxed) : 0;
+}
+
+int64 LatencyHistogram::getMax() const {
+    return maximum.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::getMean() const {
+    int64 n = getCount();
+    return n>0 ? (double)sum.load(std::memory_order_relaxed) / (double)n : 0;
+}
+
+int64 LatencyHistogram::getPercentile(double percent) const {
+    int64 total = 0;
+    for (auto& bucket : buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total==0) return 0;
+    int64 limit = jmax((int64)1, (int64)std::ceil((double)total * percent / 100.0));
+    int64 seen = 0;
+    for (int i = 0; i < numBuckets; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen>=limit) return jmin(getBucketEnd(i), getMax());
+    }
+    return getMax();
+}
@@ -0,0 +1,46 @@
+//
+//  LatencyHistogram.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+#include <atomic>
+
+// Histogram of latencies in us with fixed buckets like an HDR histogram:
+// 1 us buckets up to 32 us, above 16 buckets per power of two, so a value is
+// off by at most 1/16 (6%) up to 33 s. Adding is one relaxed atomic increment,
+// the percentiles are read while other threads add.
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void add(juce::int64 us);
+    void reset();
+
+    juce::int64 getCount() const;
+    juce::int64 getMin() const;
+    juce::int64 getMax() const;
+    double getMean() const;
+    // upper end of the bucket, which contains the percentile
+    juce::int64 getPercentile(double percent) const;
+
+    static const int numBuckets = 32 + 20 * 16;
+
+    static int getBucket(juce::int64 us);
+    static juce::int64 getBucketStart(int bucket);
+    static juce::int64 getBucketEnd(int bucket);
+
+private:
+    std::atomic<juce::uint32> buckets[numBuckets];
+    std::atomic<juce::int64> count;
+    std::atomic<juce::int64> sum;
+    std::atomic<juce::int64> minimum;
+    std::atomic<juce::int64> maximum;
+
+    JUCE_DECLARE_NON_COPYABLE (LatencyHistogram)
+};
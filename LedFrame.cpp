@@ -0,0 +1,142 @@
+//
+//  LedFrame.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "LedFrame.hpp"
+
+using namespace juce;
+
+LedFrame::LedFrame(int frameWidth, int frameHeight) {
+    width = frameWidth;
+    height = frameHeight;
+    indexed = false;
+    mask = 0x00ffffff;
+    pixels.insertMultiple(0, 0, width * height);
+}
+
+void LedFrame::setIndexed(bool isIndexed) {
+    indexed = isIndexed;
+    mask = indexed ? 0x0f : 0x00ffffff;
+    clear();
+}
+
+uint32 LedFrame::getPixel(int x, int y) const {
+    if (x<0 || y<0 || x>=width || y>=height) return 0;
+    return pixels.getUnchecked(x + y * width);
+}
+
+uint32 LedFrame::getLED(int ledNr) const {
+    if (ledNr<0 || ledNr>=pixels.size()) return 0;
+    return pixels.getUnchecked(ledNr);
+}
+
+void LedFrame::setPixel(int x, int y, uint32 colour) {
+    if (x<0 || y<0 || x>=width || y>=height) return;
+    pixels.set(x + y * width, colour & mask);
+}
+
+void LedFrame::drawLED(int ledNr, uint32 colour) {
+    // the block would write outside of its led store, we just ignore it
+    if (ledNr<0 || ledNr>=pixels.size()) return;
+    pixels.set(ledNr, colour & mask);
+}
+
+void LedFrame::blendLED(int ledNr, uint32 colour) {
+    if (ledNr<0 || ledNr>=pixels.size() || indexed) return;
+    pixels.set(ledNr, (colour & mask) | pixels.getUnchecked(ledNr));
+}
+
+void LedFrame::drawRect(int ledNr, int w, int h, uint32 colour) {
+    for (int i = ledNr; i<ledNr + w; ++i) {
+        for (int j = 0; j<h; ++j) {
+            drawLED(i + j*width, colour);
+        }
+    }
+}
+
+void LedFrame::drawCircle(int cx, int cy, int r, uint32 colour) {
+    int red = (colour & 0x00ff0000) >> 16;
+    int green = (colour & 0x0000ff00) >> 8;
+    int blue = (colour & 0x000000ff);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            int a = x - cx;
+            int b = y - cy;
+            int sqr = a*a + b*b;
+            if (sqr <= r*r) {
+                drawLED(x + y*width, colour);
+            } else {
+                int rm = r+1;
+                if (sqr < rm*rm) {
+                    // darkened edge, float maths as on the block
+                    float diff = rm*rm - r*r;
+                    float alpha = (sqr - r*r) / diff;
+                    alpha = alpha * 2.5f;
+                    int rDark = red - int(float(red)*alpha);
+                    if (rDark<0) rDark = 0;
+                    int bDark = blue - int(float(blue)*alpha);
+                    if (bDark<0) bDark = 0;
+                    int gDark = green - int(float(green)*alpha);
+                    if (gDark<0) gDark = 0;
+                    blendLED(x + y*width, (uint32)((rDark << 16) + (gDark << 8) + bDark));
+                }
+            }
+        }
+    }
+}
+
+void LedFrame::drawTriangle(int x, int y, int s, int deg, uint32 c) {
+    for (int a = 0; a < s; ++a) {
+        for (int b = a; b < s; ++b) {
+            if (deg==0) drawLED(x+a/2 + (y+b-(a/2))*width, c); // 0
+            else if (deg==1) drawLED(x+(s-1)-a + (y+b)*width, c); // 45
+            else if (deg==2) drawLED(x+b-(a/2) + (y+a/2)*width, c); // 90
+            else if (deg==3) drawLED(x+a + (y+b)*width, c); // 135
+            else if (deg==4) drawLED(x+(s-1)/2-a/2 + (y+b-(a/2))*width, c); // 180
+            else if (deg==5) drawLED(x+(s-1)-b + (y+a)*width, c); // 225
+            else if (deg==6) drawLED(x+b-(a/2) + (y+(s-1)/2-a/2)*width, c); // 270
+            else if (deg==7) drawLED(x+b + (y+a)*width, c); // 315
+        }
+    }
+}
+
+void LedFrame::clear() {
+    pixels.fill(0);
+}
+
+void LedFrame::fillRect(int x, int y, int w, int h, uint32 colour) {
+    int x1 = jmax(x, 0);
+    int y1 = jmax(y, 0);
+    int x2 = jmin(x + w, width);
+    int y2 = jmin(y + h, height);
+    if (x2<=x1 || y2<=y1) return;
+    drawRect(x1 + y1 * width, x2 - x1, y2 - y1, colour);
+}
+
+bool LedFrame::isBlack() const {
+    for (auto pixel : pixels) {
+        if (pixel!=0) return false;
+    }
+    return true;
+}
+
+uint32 LedFrame::getRowChecksum(int y) const {
+    if (y<0 || y>=height) return 0;
+    uint32 sum1 = 1;
+    uint32 sum2 = 0;
+    for (int x = 0; x < width; ++x) {
+        uint32 colour = getPixel(x, y);
+        for (int shift = indexed ? 0 : 16; shift >= 0; shift -= 8) {
+            sum1 = (sum1 + ((colour >> shift) & 0xff)) % 65521;
+            sum2 = (sum2 + sum1) % 65521;
+        }
+    }
+    return (sum2 << 16) | sum1;
+}
+
+bool LedFrame::operator== (const LedFrame& other) const {
+    return width==other.width && height==other.height && indexed==other.indexed && pixels==other.pixels;
+}
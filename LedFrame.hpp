@@ -0,0 +1,58 @@
+//
+//  LedFrame.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+
+// Host side copy of an LED store. The drawing functions follow the rules of
+// the LittleFoot program (see LightpadProgram.cpp), so a 15 x 15 frame always
+// shows the same pixels as the heap of the block it mirrors.
+class LedFrame
+{
+public:
+    LedFrame (int frameWidth = 15, int frameHeight = 15);
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // with a palette the leds are 4 bit palette indexes and can't be blended
+    void setIndexed(bool isIndexed);
+    bool isIndexed() const { return indexed; }
+
+    // colours are stored as 0x00rrggbb, pixels outside of the frame are black
+    juce::uint32 getPixel(int x, int y) const;
+    juce::uint32 getLED(int ledNr) const;
+    void setPixel(int x, int y, juce::uint32 colour);
+
+    // same as the LittleFoot functions, leds are addressed with x + y * width
+    void drawLED(int ledNr, juce::uint32 colour);
+    void blendLED(int ledNr, juce::uint32 colour);
+    void drawRect(int ledNr, int w, int h, juce::uint32 colour);
+    void drawCircle(int cx, int cy, int r, juce::uint32 colour);
+    void drawTriangle(int x, int y, int s, int deg, juce::uint32 colour);
+    void clear();
+
+    // rectangle in x / y coordinates, clipped to the frame
+    void fillRect(int x, int y, int w, int h, juce::uint32 colour);
+
+    bool isBlack() const;
+
+    // adler-32 of a row like the LittleFoot program computes it: over the bytes
+    // r g b of each led (the palette index with a palette)
+    juce::uint32 getRowChecksum(int y) const;
+
+    bool operator== (const LedFrame& other) const;
+    bool operator!= (const LedFrame& other) const { return !operator== (other); }
+
+private:
+    int width;
+    int height;
+    bool indexed;
+    juce::uint32 mask;
+    juce::Array<juce::uint32> pixels;
+};
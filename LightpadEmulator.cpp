@@ -0,0 +1,599 @@
+//
+//  LightpadEmulator.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "LightpadEmulator.hpp"
+#include "BlockComponent.hpp"
+
+using namespace juce;
+
+static const int heapSize = 1549;
+
+LightpadEmulator::LightpadEmulator(int64 seed) : random(seed) {
+    latency = 0;
+    jitter = 0;
+    lossRate = 0;
+    bandwidth = 0;
+    linkFreeTime = 0;
+    lastDeviceTime = 0;
+    linkBufferSize = 0;
+    component = nullptr;
+    numReceived = 0;
+    numSent = 0;
+    numLost = 0;
+    for (int i = 0; i < 24; i++) {
+        startX[i] = 0;
+        startY[i] = 0;
+    }
+
+    heap.calloc(heapSize);
+    initialise();
+    startTimer(1);
+}
+
+LightpadEmulator::~LightpadEmulator() {
+    stopTimer();
+}
+
+void LightpadEmulator::setComponent(BlockComponent* componentToUse) {
+    component = componentToUse;
+}
+
+void LightpadEmulator::setLatency(double latencyMs, double jitterMs) {
+    latency = latencyMs;
+    jitter = jitterMs;
+}
+
+void LightpadEmulator::setLossRate(double probability) {
+    lossRate = probability;
+}
+
+void LightpadEmulator::setBandwidth(double messagesPerSecond) {
+    bandwidth = messagesPerSecond;
+}
+
+void LightpadEmulator::setLinkBufferSize(int numMessages) {
+    linkBufferSize = numMessages;
+}
+
+void LightpadEmulator::sendProgramEvent(const Block::ProgramEventMessage& message) {
+    Event event;
+    event.type = hostMessage;
+    event.message = message;
+    queueEvent(event, true);
+}
+
+void LightpadEmulator::touchStart(int index, float x, float y, float z) {
+    startX[index % 24] = x;
+    startY[index % 24] = y;
+    queueTouch(index, x, y, z, 1);
+    handleTouch(index + 1, x, y, z, 1);
+}
+
+void LightpadEmulator::touchMove(int index, float x, float y, float z) {
+    queueTouch(index, x, y, z, 2);
+    handleTouch(index + 1, x, y, z, 2);
+}
+
+void LightpadEmulator::touchEnd(int index, float x, float y, float z) {
+    queueTouch(index, x, y, z, 0);
+    handleTouch(index + 1, x, y, z, 0);
+}
+
+void LightpadEmulator::pressButton(bool pressed) {
+    Event event;
+    event.type = buttonEvent;
+    event.pressed = pressed;
+    queueEvent(event, false);
+}
+
+void LightpadEmulator::queueTouch(int index, float x, float y, float z, int phase) {
+    // the touch as the sdk delivers it to the TouchSurface::Listener
+    Event event;
+    event.type = touchEvent;
+    event.touch.index = index;
+    event.touch.x = x;
+    event.touch.y = y;
+    event.touch.z = z;
+    event.touch.xVelocity = 0;
+    event.touch.yVelocity = 0;
+    event.touch.zVelocity = phase==1 ? z : 0;
+    event.touch.startX = startX[index % 24];
+    event.touch.startY = startY[index % 24];
+    event.touch.isTouchStart = phase==1;
+    event.touch.isTouchEnd = phase==0;
+    event.touch.blockUID = 0;
+    event.touch.eventTimestamp = Time::getMillisecondCounter();
+    queueEvent(event, false);
+}
+
+void LightpadEmulator::queueEvent(Event& event, bool canBeLost) {
+    const ScopedLock sl (eventLock);
+    double sendTime = Time::getMillisecondCounterHiRes();
+    if (event.type==hostMessage && bandwidth>0) {
+        // the buffer overruns
+        if (linkBufferSize>0 && (linkFreeTime - sendTime) * bandwidth / 1000.0>=linkBufferSize) {
+            numLost++;
+            return;
+        }
+        // also lost messages use the link
+        linkFreeTime = jmax(linkFreeTime, sendTime) + 1000.0 / bandwidth;
+        sendTime = linkFreeTime;
+    }
+    if (canBeLost && lossRate>0 && random.nextDouble()<lossRate) {
+        numLost++;
+        return;
+    }
+    event.time = sendTime + latency;
+    if (jitter>0) {
+        event.time += random.nextDouble() * jitter;
+    }
+    // the echos, touches and buttons arrive in the order the block sent them
+    if (event.type!=hostMessage) {
+        event.time = jmax(event.time, lastDeviceTime);
+        lastDeviceTime = event.time;
+    }
+    // sorted by time, events with the same time keep their order
+    int i = events.size();
+    while (i>0 && events.getReference(i - 1).time>event.time) {
+        i--;
+    }
+    events.insert(i, event);
+}
+
+int LightpadEmulator::numPendingEvents() {
+    const ScopedLock sl (eventLock);
+    return events.size();
+}
+
+void LightpadEmulator::processEvents() {
+    double now = Time::getMillisecondCounterHiRes();
+    for (;;) {
+        Event event;
+        {
+            const ScopedLock sl (eventLock);
+            if (events.size()==0 || events.getReference(0).time>now) break;
+            event = events.removeAndReturn(0);
+        }
+        switch (event.type) {
+            case hostMessage:
+                numReceived++;
+                handleMessage(event.message.values[0], event.message.values[1], event.message.values[2]);
+                break;
+            case deviceMessage:
+                if (component!=nullptr) component->receiveProgramEvent(event.message);
+                break;
+            case touchEvent:
+                if (component!=nullptr) component->receiveTouch(event.touch);
+                break;
+            case buttonEvent:
+                if (component!=nullptr) component->receiveButton(event.pressed);
+                break;
+        }
+    }
+    repaint();
+}
+
+void LightpadEmulator::timerCallback() {
+    processEvents();
+}
+
+void LightpadEmulator::sendMessageToHost(int param1, int param2, int param3) {
+    numSent++;
+    Event event;
+    event.type = deviceMessage;
+    event.message.values[0] = param1;
+    event.message.values[1] = param2;
+    event.message.values[2] = param3;
+    queueEvent(event, true);
+}
+
+int LightpadEmulator::getHeapByte(int byte) const {
+    if (byte<0 || byte>=heapSize) return 0;
+    return heap[byte];
+}
+
+int LightpadEmulator::getHeapInt(int byte) const {
+    // little endian as on the block
+    return (int)((uint32)getHeapByte(byte) | ((uint32)getHeapByte(byte + 1) << 8)
+                 | ((uint32)getHeapByte(byte + 2) << 16) | ((uint32)getHeapByte(byte + 3) << 24));
+}
+
+void LightpadEmulator::setHeapByte(int byte, int value) {
+    if (byte<0 || byte>=heapSize) return;
+    heap[byte] = (uint8)value;
+}
+
+void LightpadEmulator::setHeapInt(int byte, int value) {
+    for (int i = 0; i < 4; i++) {
+        setHeapByte(byte + i, (int)(((uint32)value >> (i * 8)) & 0xff));
+    }
+}
+
+LedFrame LightpadEmulator::getDisplayedFrame() const {
+    LedFrame frame;
+    for (int ledNr = 0; ledNr < 225; ledNr++) {
+        if (indexedColor) {
+            int index = getPaletteIndex(displayOffset, ledNr);
+            frame.drawLED(ledNr, (uint32)getHeapInt(146 + index*4) & 0x00ffffff);
+        } else {
+            int byte = ledNr * 3 + displayOffset;
+            frame.drawLED(ledNr, (uint32)((getHeapByte(byte) << 16) + (getHeapByte(byte + 1) << 8) + getHeapByte(byte + 2)));
+        }
+    }
+    return frame;
+}
+
+// LittleFoot program
+
+void LightpadEmulator::initialise() {
+    activeObjects = 0;
+    buttonTouch = false;
+    numObjects = 0;
+    setBuffers();
+    int colours[6] = {(int)0xff87ceeb, (int)0xff98fb98, (int)0xffffe4e1, (int)0xff9370db, (int)0xfffffacd, (int)0xff008b8b};
+    for (int i = 0; i < 25; i++) {
+        setHeapInt(2 + i*4, colours[i % 6]);
+    }
+}
+
+void LightpadEmulator::handleMessage(int param1, int param2, int param3) {
+    int command = (param1 >> 26) & 0x3F;
+    int subCommand = (param1 >> 18) & 0xFF;
+    if (command==0) {
+        if (subCommand==0) {
+            setHeapByte(0, param3);
+        } else if (subCommand==1) {
+            setHeapByte(1, param3);
+        }
+    } else if (command==1) {
+        int color1 = ((param1 << 16) & 0x00ff0000) + ((param2 >> 16) & 0x0000ffff) + 0xff000000;
+        int color2 = ((param2 << 8) & 0x00ffff00) + ((param3 >> 24) & 0x000000ff) + 0xff000000;
+        int color3 = (param3 & 0x00ffffff) + 0xff000000;
+        setHeapInt(2 + subCommand*4, color1);
+        setHeapInt(2 + (subCommand + 1)*4, color2);
+        setHeapInt(2 + (subCommand + 2)*4, color3);
+    } else if (command==2) {
+        setHeapInt(2 + subCommand*4, param3);
+    } else if (command==3) {
+        float value = float(param3) / 1e6;
+        if (param2==0) {
+            setFaderValue(subCommand, value);
+        } else if (param2==1) {
+            setMixerValue(subCommand+5, value);
+        } else if (param2==2) {
+            setMixerValue(subCommand, value);
+        }
+    } else if (command==4) {
+        drawLED(subCommand, param3);
+    } else if (command==5) {
+        clearScreen();
+    } else if (command==6) {
+        drawRect(subCommand, param1 & 0xff, param2, param3);
+    } else if (command==7) {
+        drawCircle(subCommand, param1 & 0xff, param2, param3);
+    } else if (command==8) {
+        drawTriangle(subCommand, param1 & 0xff, (param2 >> 16) & 0xff, param2 & 0xff, param3);
+    } else if (command==9) {
+        if (subCommand==1) {
+            setHeapInt(861, param2);
+            setHeapInt(865, param3);
+            setHeapByte(869, 1);
+        } else if (subCommand==0) {
+            setHeapByte(869, 0);
+        }
+    } else if (command==12) {
+        if (subCommand==0) {
+            if (getHeapByte(870)!=param3) {
+                if (param3==0)
+                    copyLEDs(drawOffset, displayOffset);
+                setHeapByte(870, param3);
+                setBuffers();
+                if (param3==1)
+                    copyLEDs(displayOffset, drawOffset);
+            }
+        } else if (subCommand==1) {
+            if (getHeapByte(870)==1 && getHeapByte(871)!=param3) {
+                setHeapByte(871, param3);
+                setBuffers();
+                copyLEDs(displayOffset, drawOffset);
+            }
+        }
+    } else if (command==13) {
+        if (subCommand==0) {
+            if (getHeapByte(1547)!=param3) {
+                for (int x = 0; x < 675; ++x) {
+                    setHeapByte(146 + x, 0);
+                    setHeapByte(872 + x, 0);
+                }
+                setHeapByte(1547, param3);
+                setBuffers();
+            }
+        } else {
+            int color1 = ((param1 << 16) & 0x00ff0000) + ((param2 >> 16) & 0x0000ffff) + 0xff000000;
+            int color2 = ((param2 << 8) & 0x00ffff00) + ((param3 >> 24) & 0x000000ff) + 0xff000000;
+            int color3 = (param3 & 0x00ffffff) + 0xff000000;
+            setPaletteColor(subCommand - 1, color1);
+            setPaletteColor(subCommand, color2);
+            setPaletteColor(subCommand + 1, color3);
+        }
+    } else if (command==14) {
+        if (indexedColor) {
+            for (int i = 0; i < 18; ++i) {
+                int index = 0;
+                if (i < 2) {
+                    index = param1 >> (i * 4);
+                } else if (i < 10) {
+                    index = param2 >> ((i - 2) * 4);
+                } else {
+                    index = param3 >> ((i - 10) * 4);
+                }
+                if (subCommand + i < 225)
+                    drawPaletteLED(subCommand + i, index);
+            }
+        }
+    } else if (command==15) {
+        if (indexedColor) {
+            int ledNr = subCommand;
+            for (int i = 0; i < 9; ++i) {
+                int run = param1;
+                if (i >= 5) {
+                    run = param3 >> ((i - 5) * 8);
+                } else if (i >= 1) {
+                    run = param2 >> ((i - 1) * 8);
+                }
+                int length = (run >> 4) & 0x0f;
+                drawRun(ledNr, length, run & 0x0f);
+                ledNr += length;
+            }
+        } else {
+            int length = param1 & 0xff;
+            drawRun(subCommand, length, param3);
+            drawRun(subCommand + length, (param2 >> 24) & 0xff, param2);
+        }
+    } else if (command==16) {
+        setHeapByte(1548, param3);
+    } else if (command==17) {
+        sendMessageToHost(param1, rowChecksum(subCommand), rowChecksum(subCommand + 1));
+        return;
+    }
+    if (getHeapByte(1548)==1 && (command==4 || command==14 || command==15))
+        return;
+    // send back message for confirmation
+    sendMessageToHost(param1, 0, 0);
+}
+
+void LightpadEmulator::handleTouch(int index, float x, float y, float z, int phase) {
+    int mode = getHeapByte(0);
+    int touchByte = 122 + index - 1;
+    if (mode==1) {
+        if (phase==1) {
+            int padIndex = getObjectIndex(x, y);
+            setHeapByte(touchByte, padIndex);
+            setObjectActive(padIndex, true);
+        } else if (phase==0) {
+            setObjectActive(getHeapByte(touchByte), false);
+        }
+    } else if (mode==2) {
+        float max = 1.931510272f;
+        float min = 0.071419848f;
+        float value = jlimit(0.0f, 1.0f, 1 - (y-min)/(max-min));
+        int faderIndex = getHeapByte(touchByte);
+        if (phase==1) {
+            faderIndex = getObjectIndex(x, 2.0f);
+            setHeapByte(touchByte, faderIndex);
+        }
+        if (phase!=0) {
+            setFaderValue(faderIndex, value);
+        }
+        sendMessageToHost((10 << 26) + faderIndex, phase, int(value*1e6));
+    } else if (mode==5) {
+        float max = 1.931510272f;
+        float min = 0.531454406857143f;
+        float value = jlimit(0.0f, 1.0f, 1 - (y-min)/(max-min));
+        if (phase==1) {
+            if (y<min-0.2f) {
+                int padIndex = getObjectIndex(x, 2.0f);
+                bool on = getMixerValue(padIndex+5)!=0;
+                setMixerValue(padIndex+5, float(!on));
+                buttonTouch = true;
+                sendMessageToHost((11 << 26) + 0, padIndex, int(!on));
+            } else {
+                buttonTouch = false;
+                int faderIndex = getObjectIndex(x, 2.0f);
+                setHeapByte(touchByte, faderIndex);
+                setMixerValue(faderIndex, value);
+                sendMessageToHost((11 << 26) + 1, faderIndex, int(value*1e6));
+            }
+        } else if (phase==2 && y>=min-0.1f && !buttonTouch) {
+            int faderIndex = getHeapByte(touchByte);
+            setMixerValue(faderIndex, value);
+            sendMessageToHost((11 << 26) + 1, faderIndex, int(value*1e6));
+        }
+    }
+}
+
+void LightpadEmulator::repaint() {
+    // the program takes the object count only when it draws pads, faders or the mixer
+    int mode = getHeapByte(0);
+    if (mode==1 || mode==2 || mode==5) {
+        numObjects = getHeapByte(1);
+    }
+}
+
+void LightpadEmulator::setBuffers() {
+    int first = 146;
+    int second = 872;
+    bufferSize = 675;
+    indexedColor = getHeapByte(1547)==1;
+    if (indexedColor) {
+        first = 210;
+        second = 323;
+        bufferSize = 113;
+    }
+    displayOffset = first;
+    if (getHeapByte(871)==1)
+        displayOffset = second;
+    drawOffset = displayOffset;
+    if (getHeapByte(870)==1)
+        drawOffset = first + second - displayOffset;
+}
+
+void LightpadEmulator::copyLEDs(int from, int to) {
+    for (int x = 0; x < bufferSize; ++x) {
+        setHeapByte(to + x, getHeapByte(from + x));
+    }
+}
+
+void LightpadEmulator::setPaletteColor(int index, int colour) {
+    if (index < 16)
+        setHeapInt(146 + index*4, colour);
+}
+
+int LightpadEmulator::getPaletteIndex(int offset, int ledNr) const {
+    int value = getHeapByte(offset + ledNr / 2);
+    if (ledNr % 2 == 1)
+        value = value >> 4;
+    return value & 0x0f;
+}
+
+void LightpadEmulator::drawPaletteLED(int ledNr, int index) {
+    int byte = drawOffset + ledNr / 2;
+    int value = getHeapByte(byte);
+    if (ledNr % 2 == 0) {
+        value = (value & 0xf0) | (index & 0x0f);
+    } else {
+        value = (value & 0x0f) | ((index & 0x0f) << 4);
+    }
+    setHeapByte(byte, value);
+}
+
+void LightpadEmulator::drawLED(int ledNr, int colour) {
+    if (indexedColor) {
+        drawPaletteLED(ledNr, colour);
+        return;
+    }
+    int byte = ledNr * 3 + drawOffset;
+    setHeapByte(byte, (colour & 0x00ff0000) >> 16);
+    setHeapByte(byte + 1, (colour & 0x0000ff00) >> 8);
+    setHeapByte(byte + 2, colour & 0x000000ff);
+}
+
+void LightpadEmulator::blendLED(int ledNr, int colour) {
+    if (indexedColor)
+        return;
+    int byte = ledNr * 3 + drawOffset;
+    setHeapByte(byte, ((colour & 0x00ff0000) >> 16) | getHeapByte(byte));
+    setHeapByte(byte + 1, ((colour & 0x0000ff00) >> 8) | getHeapByte(byte + 1));
+    setHeapByte(byte + 2, (colour & 0x000000ff) | getHeapByte(byte + 2));
+}
+
+int LightpadEmulator::rowChecksum(int row) const {
+    if (row >= 15)
+        return 0;
+    int sum1 = 1;
+    int sum2 = 0;
+    for (int ledNr = row * 15; ledNr < row * 15 + 15; ++ledNr) {
+        if (indexedColor) {
+            sum1 = (sum1 + getPaletteIndex(drawOffset, ledNr)) % 65521;
+            sum2 = (sum2 + sum1) % 65521;
+        } else {
+            for (int c = 0; c < 3; ++c) {
+                sum1 = (sum1 + getHeapByte(drawOffset + ledNr * 3 + c)) % 65521;
+                sum2 = (sum2 + sum1) % 65521;
+            }
+        }
+    }
+    return (int)(((uint32)sum2 << 16) | (uint32)sum1);
+}
+
+void LightpadEmulator::drawRun(int ledNr, int length, int colour) {
+    for (int i = ledNr; i < ledNr + length; ++i) {
+        if (i < 225)
+            drawLED(i, colour);
+    }
+}
+
+void LightpadEmulator::drawRect(int ledNr, int w, int h, int colour) {
+    for (int i = ledNr; i<ledNr + w; ++i) {
+        for (int j = 0; j<h; ++j) {
+            drawLED(i + j*15, colour);
+        }
+    }
+}
+
+void LightpadEmulator::drawCircle(int cx, int cy, int r, int colour) {
+    int red = (colour & 0x00ff0000) >> 16;
+    int green = (colour & 0x0000ff00) >> 8;
+    int blue = (colour & 0x000000ff);
+    for (int y = 0; y < 15; ++y) {
+        for (int x = 0; x < 15; ++x) {
+            int a = x - cx;
+            int b = y - cy;
+            int sqr = a*a + b*b;
+            if (sqr <= r*r) {
+                drawLED(x + y*15, (int)(0xff000000 + (red << 16) + (green << 8) + blue));
+            } else {
+                int rm = r+1;
+                if (sqr < rm*rm) {
+                    float diff = rm*rm - r*r;
+                    float alpha = (sqr - r*r) / diff;
+                    alpha = alpha * 2.5f;
+                    int rDark = red - int(float(red)*alpha);
+                    if (rDark<0) rDark = 0;
+                    int bDark = blue - int(float(blue)*alpha);
+                    if (bDark<0) bDark = 0;
+                    int gDark = green - int(float(green)*alpha);
+                    if (gDark<0) gDark = 0;
+                    blendLED(x + y*15, (int)(0xff000000 + (rDark << 16) + (gDark << 8) + bDark));
+                }
+            }
+        }
+    }
+}
+
+void LightpadEmulator::drawTriangle(int x, int y, int s, int deg, int c) {
+    for (int a = 0; a < s; ++a) {
+        for (int b = a; b < s; ++b) {
+            if (deg==0) drawLED(x+a/2 + (y+b-(a/2))*15, c); // 0
+            else if (deg==1) drawLED(x+(s-1)-a + (y+b)*15, c); // 45
+            else if (deg==2) drawLED(x+b-(a/2) + (y+a/2)*15, c); // 90
+            else if (deg==3) drawLED(x+a + (y+b)*15, c); // 135
+            else if (deg==4) drawLED(x+(s-1)/2-a/2 + (y+b-(a/2))*15, c); // 180
+            else if (deg==5) drawLED(x+(s-1)-b + (y+a)*15, c); // 225
+            else if (deg==6) drawLED(x+b-(a/2) + (y+(s-1)/2-a/2)*15, c); // 270
+            else if (deg==7) drawLED(x+b + (y+a)*15, c); // 315
+        }
+    }
+}
+
+void LightpadEmulator::clearScreen() {
+    for (int x = 0; x < bufferSize; ++x) {
+        setHeapByte(x + drawOffset, 0);
+    }
+}
+
+int LightpadEmulator::getObjectIndex(float x, float y) const {
+    int row = int (y * (0.95 / 2.0) * float (numObjects)) + 1;
+    int col = int (x * (0.95 / 2.0) * float (numObjects));
+    return (numObjects * (numObjects-row)) + col;
+}
+
+void LightpadEmulator::setObjectActive(int objIndex, bool active) {
+    activeObjects = active ? (activeObjects | (1 << objIndex)) : (activeObjects & ~(1 << objIndex));
+}
+
+void LightpadEmulator::setFaderValue(int objIndex, float value) {
+    setHeapInt(102 + objIndex*4, int(value*1e6));
+}
+
+float LightpadEmulator::getMixerValue(int objIndex) const {
+    return float(getHeapInt(821 + objIndex*4))/1e6;
+}
+
+void LightpadEmulator::setMixerValue(int objIndex, float value) {
+    setHeapInt(821 + objIndex*4, int(value*1e6));
+}
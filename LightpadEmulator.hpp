@@ -0,0 +1,145 @@
+//
+//  LightpadEmulator.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+#include "LightpadLink.hpp"
+#include "LedFrame.hpp"
+
+class BlockComponent;
+
+// Lightpad without hardware: runs the message handling and touch handling of
+// the LittleFoot program (see LightpadProgram.cpp) on a copy of its heap.
+// Messages in both directions can be delayed and lost, the messages to the
+// block also reordered, so the acknowledge and resend logic of a BlockComponent
+// can be tested and measured. The block sends its messages one after another.
+class LightpadEmulator : public LightpadLink,
+                         private juce::Timer
+{
+public:
+    LightpadEmulator (juce::int64 seed = 1);
+    ~LightpadEmulator();
+
+    // the component, which receives the echos, fader / mixer messages and touches
+    void setComponent(BlockComponent* componentToUse);
+
+    // delay of every message in ms, a random jitter on top reorders the messages to the block
+    void setLatency(double latencyMs, double jitterMs = 0);
+    // probability to lose a message, in each direction
+    void setLossRate(double probability);
+    // messages per second to the block (0 = unlimited), the messages wait for the link
+    void setBandwidth(double messagesPerSecond);
+    // messages, which can wait for the link (0 = unlimited), more are lost
+    void setLinkBufferSize(int numMessages);
+
+    // from the host
+    void sendProgramEvent(const juce::Block::ProgramEventMessage& message) override;
+
+    // touch with the device coordinates (0 - 2), index starts at 0
+    void touchStart(int index, float x, float y, float z);
+    void touchMove(int index, float x, float y, float z);
+    void touchEnd(int index, float x, float y, float z);
+    void pressButton(bool pressed);
+
+    // deliver the messages, which are due (also called by a 1 ms timer)
+    void processEvents();
+    int numPendingEvents();
+
+    // heap of the LittleFoot program
+    int getHeapByte(int byte) const;
+    int getHeapInt(int byte) const;
+
+    // the shown leds as 0x00rrggbb (the palette colors with palette mode)
+    LedFrame getDisplayedFrame() const;
+
+    // counters
+    int numReceived;
+    int numSent;
+    int numLost;
+
+private:
+    enum EventType
+    {
+        hostMessage,    // to the block
+        deviceMessage,  // to the host
+        touchEvent,
+        buttonEvent
+    };
+
+    struct Event
+    {
+        double time;
+        EventType type;
+        juce::Block::ProgramEventMessage message;
+        juce::TouchSurface::Touch touch;
+        bool pressed;
+    };
+
+    juce::Array<Event> events;
+    juce::CriticalSection eventLock;
+    juce::Random random;
+    double latency;
+    double jitter;
+    double lossRate;
+    double bandwidth;
+    double linkFreeTime;
+    // arrival of the last message from the block
+    double lastDeviceTime;
+    int linkBufferSize;
+
+    BlockComponent *component;
+
+    // LittleFoot program
+    juce::HeapBlock<juce::uint8> heap;
+    int activeObjects;
+    bool buttonTouch;
+    // the object count of the last repaint, used by the touches like in the program
+    int numObjects;
+    int drawOffset;
+    int displayOffset;
+    int bufferSize;
+    bool indexedColor;
+
+    float startX[24];
+    float startY[24];
+
+    void queueEvent(Event& event, bool canBeLost);
+    void queueTouch(int index, float x, float y, float z, int phase);
+    void sendMessageToHost(int param1, int param2, int param3);
+    void timerCallback() override;
+
+    void initialise();
+    void handleMessage(int param1, int param2, int param3);
+    void handleTouch(int index, float x, float y, float z, int phase);
+    void repaint();
+
+    void setHeapByte(int byte, int value);
+    void setHeapInt(int byte, int value);
+
+    void setBuffers();
+    void copyLEDs(int from, int to);
+    void setPaletteColor(int index, int colour);
+    int getPaletteIndex(int offset, int ledNr) const;
+    int rowChecksum(int row) const;
+    void drawPaletteLED(int ledNr, int index);
+    void drawLED(int ledNr, int colour);
+    void blendLED(int ledNr, int colour);
+    void drawRun(int ledNr, int length, int colour);
+    void drawRect(int ledNr, int w, int h, int colour);
+    void drawCircle(int cx, int cy, int r, int colour);
+    void drawTriangle(int x, int y, int s, int deg, int c);
+    void clearScreen();
+
+    int getObjectIndex(float x, float y) const;
+    void setObjectActive(int objIndex, bool active);
+    void setFaderValue(int objIndex, float value);
+    float getMixerValue(int objIndex) const;
+    void setMixerValue(int objIndex, float value);
+
+    JUCE_LEAK_DETECTOR (LightpadEmulator)
+};
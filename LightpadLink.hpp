@@ -0,0 +1,20 @@
+//
+//  LightpadLink.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+
+// Connection to the LittleFoot program of a Lightpad. A BlockComponent sends
+// over its block, unless it was created with a link (e.g. the emulator).
+class LightpadLink
+{
+public:
+    virtual ~LightpadLink() {}
+
+    virtual void sendProgramEvent(const juce::Block::ProgramEventMessage& message) = 0;
+};
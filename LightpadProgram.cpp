@@ -16,7 +16,7 @@ String LightpadProgram::getLittleFootProgram()
 {
     return R"littlefoot(
         
-        #heapsize: 870
+        #heapsize: 1549
         
         //==============================================================================
         /*
@@ -55,6 +55,29 @@ String LightpadProgram::getLittleFootProgram()
            
            861   9 byte ( 4 byte number / 4 byte color / 1 byte mode)
            
+           === Double Buffering ===
+           
+           870   1 byte       double buffering on / off
+           871   1 byte       displayed led buffer (0 = 146, 1 = 872)
+           872   3 byte x 225 second led buffer
+           
+           === Palette Colors ===
+           
+           1547  1 byte       color mode (0 = rgb, 1 = 16 color palette)
+           
+           === Verified Drawing ===
+           
+           1548  1 byte       no echo for leds, packed leds and runs (checked with the row checksums)
+           
+           1549 bytes in total: 1547 up to the second led buffer, the color mode and the
+           verified drawing add a byte each
+           
+           with the palette the first led buffer is used as follows:
+           
+           146   4 byte x 16  palette colors
+           210   4 bit x 225  led palette indexes
+           323   4 bit x 225  second led palette indexes
+           
         */
         //==============================================================================
         
@@ -63,9 +86,14 @@ String LightpadProgram::getLittleFootProgram()
         int spaceWidth;
         int activeObjects;
         bool buttonTouch;
+        int drawOffset;
+        int displayOffset;
+        int bufferSize;
+        bool indexedColor;
         
         void initialise() {
             activeObjects = 0;
+            setBuffers();
             // fill colors
             int colIndex = 0;
             for (int i = 0; i < 25; i++) {
@@ -280,21 +308,77 @@ String LightpadProgram::getLittleFootProgram()
             fillRect(0xffffff, 0, 14, 15, 1);
         }
         
+        void setBuffers() {
+            int first = 146;
+            int second = 872;
+            bufferSize = 675;
+            indexedColor = getHeapByte(1547)==1;
+            if (indexedColor) {
+                first = 210;
+                second = 323;
+                bufferSize = 113;
+            }
+            // drawing goes to the hidden buffer, if double buffering is on
+            displayOffset = first;
+            if (getHeapByte(871)==1)
+                displayOffset = second;
+            drawOffset = displayOffset;
+            if (getHeapByte(870)==1)
+                drawOffset = first + second - displayOffset;
+        }
+        
+        void copyLEDs(int from, int to) {
+            for (int x = 0; x < bufferSize; ++x) {
+                setHeapByte(to + x, getHeapByte(from + x));
+            }
+        }
+        
+        void setPaletteColor(int index, int colour) {
+            if (index < 16)
+                setHeapInt(146 + index*4, colour);
+        }
+        
+        int getPaletteIndex(int offset, int ledNr) {
+            int value = getHeapByte(offset + ledNr / 2);
+            if (ledNr % 2 == 1)
+                value = value >> 4;
+            return value & 0x0f;
+        }
+        
+        void drawPaletteLED(int ledNr, int index) {
+            // two leds per byte, the first one in the lower 4 bits
+            int byte = drawOffset + ledNr / 2;
+            int value = getHeapByte(byte);
+            if (ledNr % 2 == 0) {
+                value = (value & 0xf0) | (index & 0x0f);
+            } else {
+                value = (value & 0x0f) | ((index & 0x0f) << 4);
+            }
+            setHeapByte(byte, value);
+        }
+        
         void drawLED(int ledNr, int colour) {
+            if (indexedColor) {
+                // colour is the palette index
+                drawPaletteLED(ledNr, colour);
+                return;
+            }
             int red = (colour & 0x00ff0000) >> 16;
             int green = (colour & 0x0000ff00) >> 8;
             int blue = (colour & 0x000000ff);
-            int byte = ledNr * 3 + 146;
+            int byte = ledNr * 3 + drawOffset;
             setHeapByte(byte, red);
             setHeapByte(byte + 1, green);
             setHeapByte(byte + 2, blue);
         }
         
         void blendLED(int ledNr, int colour) {
+            if (indexedColor)
+                return;
             int red = (colour & 0x00ff0000) >> 16;
             int green = (colour & 0x0000ff00) >> 8;
             int blue = (colour & 0x000000ff);
-            int byte = ledNr * 3 + 146;
+            int byte = ledNr * 3 + drawOffset;
             red = red | getHeapByte(byte);
             green = green | getHeapByte(byte + 1);
             blue = blue | getHeapByte(byte + 2);
@@ -303,6 +387,33 @@ String LightpadProgram::getLittleFootProgram()
             setHeapByte(byte + 2, blue);
         }
         
+        int rowChecksum(int row) {
+            // adler-32 over r g b of each led in the draw buffer (or the palette index)
+            if (row >= 15)
+                return 0;
+            int sum1 = 1;
+            int sum2 = 0;
+            for (int ledNr = row * 15; ledNr < row * 15 + 15; ++ledNr) {
+                if (indexedColor) {
+                    sum1 = (sum1 + getPaletteIndex(drawOffset, ledNr)) % 65521;
+                    sum2 = (sum2 + sum1) % 65521;
+                } else {
+                    for (int c = 0; c < 3; ++c) {
+                        sum1 = (sum1 + getHeapByte(drawOffset + ledNr * 3 + c)) % 65521;
+                        sum2 = (sum2 + sum1) % 65521;
+                    }
+                }
+            }
+            return (sum2 << 16) | sum1;
+        }
+        
+        void drawRun(int ledNr, int length, int colour) {
+            for (int i = ledNr; i < ledNr + length; ++i) {
+                if (i < 225)
+                    drawLED(i, colour);
+            }
+        }
+        
         void drawRect(int ledNr, int w, int h, int colour) {
             for (int i = ledNr; i<ledNr + w; ++i) {
                 for (int j = 0; j<h; ++j) {
@@ -400,16 +511,20 @@ String LightpadProgram::getLittleFootProgram()
         }
         
         void clearScreen() {
-            for (int x = 0; x < 675; ++x) {
-                int byte = x + 146;
+            for (int x = 0; x < bufferSize; ++x) {
+                int byte = x + drawOffset;
                 setHeapByte(byte, 0);
             }
         }
         
         void drawPainting() {
+            if (indexedColor) {
+                drawPalettePainting();
+                return;
+            }
             for (int y = 0; y < 15; ++y) {
                 for (int x = 0; x < 15; ++x) {
-                    int byte = (x + y * 15) * 3 + 146;
+                    int byte = (x + y * 15) * 3 + displayOffset;
                     int red = getHeapByte(byte);
                     int green = getHeapByte(byte + 1);
                     int blue = getHeapByte(byte + 2);
@@ -419,6 +534,15 @@ String LightpadProgram::getLittleFootProgram()
         }
         
         
+        void drawPalettePainting() {
+            for (int y = 0; y < 15; ++y) {
+                for (int x = 0; x < 15; ++x) {
+                    int index = getPaletteIndex(displayOffset, x + y * 15);
+                    fillPixel (getHeapInt(146 + index*4), x, y);
+                }
+            }
+        }
+        
         int getBitValueForNumber(int number) {
             if (number==1) {
                 return 102900258;
@@ -620,8 +744,95 @@ String LightpadProgram::getLittleFootProgram()
                     // hide overlay
                     setHeapByte(869, 0);
                 }
-            }
-            // send back message for confirmation
+            } else if (command==12) {
+                if (subCommand==0) {
+                    // double buffering on / off
+                    if (getHeapByte(870)!=param3) {
+                        if (param3==0)
+                            copyLEDs(drawOffset, displayOffset);
+                        setHeapByte(870, param3);
+                        setBuffers();
+                        if (param3==1)
+                            copyLEDs(displayOffset, drawOffset);
+                    }
+                } else if (subCommand==1) {
+                    // show buffer, resent swaps don't swap again
+                    if (getHeapByte(870)==1 && getHeapByte(871)!=param3) {
+                        setHeapByte(871, param3);
+                        setBuffers();
+                        copyLEDs(displayOffset, drawOffset);
+                    }
+                }
+            } else if (command==13) {
+                if (subCommand==0) {
+                    // color mode, clears all leds and the palette
+                    if (getHeapByte(1547)!=param3) {
+                        for (int x = 0; x < 675; ++x) {
+                            setHeapByte(146 + x, 0);
+                            setHeapByte(872 + x, 0);
+                        }
+                        setHeapByte(1547, param3);
+                        setBuffers();
+                    }
+                } else {
+                    // set 3 palette colors
+                    int color1 = ((param1 << 16) & 0x00ff0000) + ((param2 >> 16) & 0x0000ffff) + 0xff000000;
+                    int color2 = ((param2 << 8) & 0x00ffff00) + ((param3 >> 24) & 0x000000ff) + 0xff000000;
+                    int color3 = (param3 & 0x00ffffff) + 0xff000000;
+                    setPaletteColor(subCommand - 1, color1);
+                    setPaletteColor(subCommand, color2);
+                    setPaletteColor(subCommand + 1, color3);
+                }
+            } else if (command==14) {
+                // 18 packed palette indexes, starting at led subCommand
+                if (indexedColor) {
+                    for (int i = 0; i < 18; ++i) {
+                        int index = 0;
+                        if (i < 2) {
+                            index = param1 >> (i * 4);
+                        } else if (i < 10) {
+                            index = param2 >> ((i - 2) * 4);
+                        } else {
+                            index = param3 >> ((i - 10) * 4);
+                        }
+                        if (subCommand + i < 225)
+                            drawPaletteLED(subCommand + i, index);
+                    }
+                }
+            } else if (command==15) {
+                // runs of leds with the same color, starting at led subCommand
+                if (indexedColor) {
+                    // 9 runs: 4 bit length, 4 bit palette index
+                    int ledNr = subCommand;
+                    for (int i = 0; i < 9; ++i) {
+                        int run = param1;
+                        if (i >= 5) {
+                            run = param3 >> ((i - 5) * 8);
+                        } else if (i >= 1) {
+                            run = param2 >> ((i - 1) * 8);
+                        }
+                        int length = (run >> 4) & 0x0f;
+                        drawRun(ledNr, length, run & 0x0f);
+                        ledNr += length;
+                    }
+                } else {
+                    // 2 runs: length in param1 / color param3, length and color in param2
+                    int length = param1 & 0xff;
+                    drawRun(subCommand, length, param3);
+                    drawRun(subCommand + length, (param2 >> 24) & 0xff, param2);
+                }
+            } else if (command==16) {
+                // leds, packed leds and runs without echo
+                setHeapByte(1548, param3);
+            } else if (command==17) {
+                // checksums of the rows subCommand and subCommand + 1 instead of the echo
+                sendMessageToHost(param1, rowChecksum(subCommand), rowChecksum(subCommand + 1));
+                return;
+            }
+            // the host checks the leds with the checksums
+            if (getHeapByte(1548)==1 && (command==4 || command==14 || command==15))
+                return;
+            // send back message for confirmation (command 18, the ping of a stalled link, is only echoed)
             sendMessageToHost(param1, 0 , 0);
         }
         
@@ -6,6 +6,8 @@
 //  Copyright © 2020 Urban Lienert. All rights reserved.
 //
 
+#pragma once
+
 #include <BlocksHeader.h>
 
 typedef enum {
@@ -17,6 +19,16 @@ typedef enum {
     mMixer
 } b_mode;
 
+// one ProgramEventMessage for the LittleFoot program, before it gets stamped
+struct LightpadCommand
+{
+    juce::uint32 commandNr;
+    juce::uint32 subCommandNr;
+    juce::uint8 param1;
+    juce::uint32 param2;
+    juce::uint32 param3;
+};
+
 struct LightpadProgram   : public juce::Block::Program
 {
     LightpadProgram (juce::Block&);
@@ -0,0 +1,174 @@
+//
+//  Tracer.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "Tracer.hpp"
+
+using namespace juce;
+
+std::atomic<bool> Tracer::enabled(false);
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char *name;
+        double time;
+        double duration;
+        int64 value;
+        char phase;
+    };
+
+    // only written by its thread, the count is published after the event
+    struct ThreadBuffer
+    {
+        int index;
+        String threadName;
+        HeapBlock<TraceEvent> events;
+        std::atomic<int> count;
+        std::atomic<int> dropped;
+        std::atomic<int> generation;
+    };
+
+    // buffers stay alive until the end, a thread keeps a pointer to its own
+    SpinLock buffersLock;
+    Array<ThreadBuffer*> buffers;
+    std::atomic<int> generation(0);
+    std::atomic<int64> startTicks(0);
+
+    String getCurrentThreadName() {
+        MessageManager *messageManager = MessageManager::getInstanceWithoutCreating();
+        if (messageManager!=nullptr && messageManager->isThisTheMessageThread()) return "message thread";
+        if (Thread *thread = Thread::getCurrentThread()) return thread->getThreadName();
+        return "pd";
+    }
+
+    ThreadBuffer* getThreadBuffer() {
+        static thread_local ThreadBuffer *buffer = nullptr;
+        if (buffer==nullptr) {
+            buffer = new ThreadBuffer();
+            buffer->threadName = getCurrentThreadName();
+            buffer->events.malloc(Tracer::bufferSize);
+            buffer->count.store(0);
+            buffer->dropped.store(0);
+            buffer->generation.store(-1);
+            const SpinLock::ScopedLockType lock(buffersLock);
+            buffer->index = buffers.size() + 1;
+            buffers.add(buffer);
+        }
+        // first event of this trace
+        int current = generation.load(std::memory_order_acquire);
+        if (buffer->generation.load(std::memory_order_relaxed)!=current) {
+            buffer->count.store(0, std::memory_order_relaxed);
+            buffer->dropped.store(0, std::memory_order_relaxed);
+            buffer->generation.store(current, std::memory_order_release);
+        }
+        return buffer;
+    }
+
+    String escape(const String& text) {
+        return text.replace("\\", "\\\\").replace("\"", "\\\"");
+    }
+}
+
+double Tracer::now() {
+    int64 ticks = Time::getHighResolutionTicks() - startTicks.load(std::memory_order_relaxed);
+    return 1e6 * (double)ticks / (double)Time::getHighResolutionTicksPerSecond();
+}
+
+void Tracer::start() {
+    startTicks.store(Time::getHighResolutionTicks(), std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::add(char phase, const char *name, double time, double duration, int64 value) {
+    ThreadBuffer *buffer = getThreadBuffer();
+    int index = buffer->count.load(std::memory_order_relaxed);
+    if (index>=bufferSize) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& event = buffer->events[index];
+    event.name = name;
+    event.time = time;
+    event.duration = duration;
+    event.value = value;
+    event.phase = phase;
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::instant(const char *name, int64 value) {
+    if (!isEnabled()) return;
+    add('i', name, now(), 0, value);
+}
+
+void Tracer::span(const char *name, double startTime, int64 value) {
+    if (!isEnabled()) return;
+    add('X', name, startTime, now() - startTime, value);
+}
+
+void Tracer::flowStart(const char *name, int64 id) {
+    if (!isEnabled()) return;
+    add('s', name, now(), 0, id);
+}
+
+void Tracer::flowEnd(const char *name, int64 id) {
+    if (!isEnabled()) return;
+    add('f', name, now(), 0, id);
+}
+
+int Tracer::getNumDropped() {
+    int numDropped = 0;
+    int current = generation.load(std::memory_order_acquire);
+    const SpinLock::ScopedLockType lock(buffersLock);
+    for (ThreadBuffer *buffer : buffers) {
+        if (buffer->generation.load(std::memory_order_acquire)==current) {
+            numDropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    return numDropped;
+}
+
+int Tracer::stop(const File& file) {
+    enabled.store(false, std::memory_order_relaxed);
+
+    file.deleteFile();
+    FileOutputStream out(file);
+    if (out.failedToOpen()) return -1;
+
+    int numEvents = 0;
+    int current = generation.load(std::memory_order_acquire);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    const SpinLock::ScopedLockType lock(buffersLock);
+    bool first = true;
+    for (ThreadBuffer *buffer : buffers) {
+        if (buffer->generation.load(std::memory_order_acquire)!=current) continue;
+        String thread = "\"pid\": 1, \"tid\": " + String(buffer->index);
+        if (!first) out << ",\n";
+        first = false;
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", " << thread
+            << ", \"args\": {\"name\": \"" << escape(buffer->threadName) << "\"}}";
+        int count = buffer->count.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++) {
+            const TraceEvent& event = buffer->events[i];
+            out << ",\n{\"name\": \"" << escape(event.name) << "\", \"ph\": \"" << String::charToString(event.phase)
+                << "\", \"ts\": " << String(event.time, 3) << ", " << thread;
+            if (event.phase=='X') {
+                out << ", \"dur\": " << String(event.duration, 3) << ", \"args\": {\"value\": " << String(event.value) << "}}";
+            } else if (event.phase=='i') {
+                out << ", \"s\": \"t\", \"args\": {\"value\": " << String(event.value) << "}}";
+            } else {
+                // flow events bind to the enclosing span
+                out << ", \"cat\": \"message\", \"id\": " << String(event.value) << (event.phase=='f' ? ", \"bp\": \"e\"}" : "}");
+            }
+            numEvents++;
+        }
+    }
+    out << "\n]}\n";
+    out.flush();
+    return numEvents;
+}
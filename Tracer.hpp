@@ -0,0 +1,68 @@
+//
+//  Tracer.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+#include <atomic>
+
+// Spans and instant events of the message pipeline, written as Chrome trace
+// JSON (chrome://tracing or ui.perfetto.dev). Every thread writes into its own
+// buffer without locking, and when tracing is off an event costs one relaxed
+// atomic load. Names have to be string literals.
+class Tracer
+{
+public:
+    static bool isEnabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // forgets the events of the last trace
+    static void start();
+    // stops and writes the events, returns the number of events (-1 if the file can't be written)
+    static int stop(const juce::File& file);
+    // events, which didn't fit into the buffers
+    static int getNumDropped();
+
+    // us since start
+    static double now();
+
+    static void instant(const char *name, juce::int64 value = 0);
+    static void span(const char *name, double startTime, juce::int64 value = 0);
+    // arrow from the start to the end event with the same id, e.g. a message and its echo
+    static void flowStart(const char *name, juce::int64 id);
+    static void flowEnd(const char *name, juce::int64 id);
+
+    // events per thread
+    static const int bufferSize = 1 << 16;
+
+private:
+    static std::atomic<bool> enabled;
+    static void add(char phase, const char *name, double time, double duration, juce::int64 value);
+};
+
+// span from the constructor to the destructor
+class TraceSpan
+{
+public:
+    TraceSpan (const char *spanName, juce::int64 spanValue = 0)
+        : value(spanValue), name(spanName), startTime(Tracer::isEnabled() ? Tracer::now() : -1.0)
+    {
+    }
+
+    ~TraceSpan() {
+        if (startTime>=0) Tracer::span(name, startTime, value);
+    }
+
+    juce::int64 value;
+
+private:
+    const char *name;
+    double startTime;
+
+    JUCE_DECLARE_NON_COPYABLE (TraceSpan)
+};
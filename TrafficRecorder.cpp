@@ -0,0 +1,128 @@
+//
+//  TrafficRecorder.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "TrafficRecorder.hpp"
+#include <cstring>
+
+using namespace juce;
+
+// the file grows by this many records
+static const int chunkRecords = 4096;
+
+const char* TrafficRecorder::magic = "BLKT";
+
+float TrafficRecord::getFloat(int i) const {
+    float value;
+    memcpy(&value, &values[i], sizeof(float));
+    return value;
+}
+
+void TrafficRecord::setFloat(int i, float value) {
+    memcpy(&values[i], &value, sizeof(float));
+}
+
+const char* TrafficRecord::getTypeName(int type) {
+    switch (type) {
+        case sentMessage: return "sent";
+        case resentMessage: return "resent";
+        case receivedMessage: return "received";
+        case touch: return "touch";
+        case button: return "button";
+        case transmittedMessage: return "transmitted";
+        default: return "unknown";
+    }
+}
+
+TrafficRecorder::TrafficRecorder(const File& fileToUse) {
+    file = fileToUse;
+    mappedFile = nullptr;
+    numRecords = 0;
+    startTime = Time::getMillisecondCounterHiRes();
+
+    file.deleteFile();
+    if (file.create().failed() || !map(headerSize + chunkRecords * recordSize)) return;
+
+    uint8 *header = (uint8 *)mappedFile->getData();
+    uint32 fileVersion = version;
+    int64 startMillis = Time::currentTimeMillis();
+    memcpy(header, magic, 4);
+    memcpy(header + 4, &fileVersion, 4);
+    memcpy(header + 8, &startMillis, 8);
+}
+
+TrafficRecorder::~TrafficRecorder() {
+    close();
+}
+
+bool TrafficRecorder::map(int64 size) {
+    if (mappedFile!=nullptr) {
+        delete mappedFile;
+        mappedFile = nullptr;
+    }
+    {
+        // grow the file, the new bytes are zero
+        FileOutputStream out(file);
+        if (out.failedToOpen() || !out.setPosition(size) || out.truncate().failed()) return false;
+    }
+    mappedFile = new MemoryMappedFile(file, MemoryMappedFile::readWrite);
+    if (mappedFile->getData()==nullptr || (int64)mappedFile->getSize()<size) {
+        delete mappedFile;
+        mappedFile = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void TrafficRecorder::add(TrafficRecord& record) {
+    const ScopedLock scopedLock(lock);
+    if (mappedFile==nullptr) return;
+    record.time = (int64)((Time::getMillisecondCounterHiRes() - startTime) * 1000.0);
+    int64 offset = headerSize + (int64)numRecords * recordSize;
+    if (offset + recordSize > (int64)mappedFile->getSize()) {
+        if (!map(offset + chunkRecords * recordSize)) return;
+    }
+    memcpy((uint8 *)mappedFile->getData() + offset, &record, recordSize);
+    numRecords++;
+}
+
+void TrafficRecorder::recordMessage(TrafficRecord::Type type, const Block::ProgramEventMessage& message) {
+    TrafficRecord record = {};
+    record.type = (uint8)type;
+    for (int i = 0; i < 3; i++) {
+        record.values[i] = (uint32)message.values[i];
+    }
+    add(record);
+}
+
+void TrafficRecorder::recordTouch(const TouchSurface::Touch& t) {
+    TrafficRecord record = {};
+    record.type = TrafficRecord::touch;
+    record.index = (uint8)t.index;
+    record.flags = (t.isTouchStart ? 1 : 0) + (t.isTouchEnd ? 2 : 0);
+    record.setFloat(0, t.x);
+    record.setFloat(1, t.y);
+    record.setFloat(2, t.z);
+    add(record);
+}
+
+void TrafficRecorder::recordButton(bool pressed) {
+    TrafficRecord record = {};
+    record.type = TrafficRecord::button;
+    record.index = pressed ? 1 : 0;
+    add(record);
+}
+
+void TrafficRecorder::close() {
+    const ScopedLock scopedLock(lock);
+    if (mappedFile==nullptr) return;
+    delete mappedFile;
+    mappedFile = nullptr;
+    FileOutputStream out(file);
+    if (out.openedOk() && out.setPosition(headerSize + (int64)numRecords * recordSize)) {
+        out.truncate();
+    }
+}
@@ -0,0 +1,71 @@
+//
+//  TrafficRecorder.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+
+// One event between a BlockComponent and its Lightpad, 24 bytes in the file.
+struct TrafficRecord
+{
+    enum Type
+    {
+        sentMessage,        // command from the patch (not the resyncs, repairs, checksums and pings)
+        resentMessage,      // message sent again by the timer
+        receivedMessage,    // echo or fader / mixer message from the block
+        touch,              // index, flags: 1 start, 2 end, values: x y z as float
+        button,             // index: 1 pressed, 0 released
+        transmittedMessage, // message sent to the block the first time, also the internal ones
+        numTypes
+    };
+
+    juce::int64 time;   // us since the start of the recording
+    juce::uint8 type;
+    juce::uint8 index;
+    juce::uint16 flags;
+    juce::uint32 values[3];
+
+    float getFloat(int i) const;
+    void setFloat(int i, float value);
+    static const char* getTypeName(int type);
+};
+
+// Capture of the traffic of one Lightpad into a file: a 16 byte header
+// ("BLKT", version 2, start time in ms since 1970) and the records. The file is
+// memory mapped and grows in chunks, so recording only copies 24 bytes.
+class TrafficRecorder
+{
+public:
+    TrafficRecorder (const juce::File& fileToUse);
+    ~TrafficRecorder();
+
+    bool openedOk() const { return mappedFile!=nullptr; }
+    const juce::File& getFile() const { return file; }
+    int getNumRecords() const { return numRecords; }
+
+    void recordMessage(TrafficRecord::Type type, const juce::Block::ProgramEventMessage& message);
+    void recordTouch(const juce::TouchSurface::Touch& t);
+    void recordButton(bool pressed);
+
+    // truncates the file to the records, called by the destructor
+    void close();
+
+    static const int headerSize = 16;
+    static const int recordSize = 24;
+    static const juce::uint32 version = 2;
+    static const char* magic;
+
+private:
+    juce::File file;
+    juce::MemoryMappedFile *mappedFile;
+    juce::CriticalSection lock;
+    double startTime;
+    int numRecords;
+
+    void add(TrafficRecord& record);
+    bool map(juce::int64 size);
+};
@@ -0,0 +1,79 @@
+//
+//  TrafficReplayer.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#include "TrafficReplayer.hpp"
+#include "BlockComponent.hpp"
+#include "LightpadEmulator.hpp"
+#include <cstring>
+
+using namespace juce;
+
+TrafficReplayer::TrafficReplayer(const File& file)
+    : mappedFile(file, MemoryMappedFile::readOnly)
+{
+    valid = false;
+    startTime = 0;
+    numRecords = 0;
+
+    const uint8 *data = (const uint8 *)mappedFile.getData();
+    int64 size = (int64)mappedFile.getSize();
+    if (data==nullptr || size<TrafficRecorder::headerSize) return;
+    uint32 version;
+    memcpy(&version, data + 4, 4);
+    if (memcmp(data, TrafficRecorder::magic, 4)!=0 || version!=TrafficRecorder::version) return;
+    memcpy(&startTime, data + 8, 8);
+    numRecords = (int)((size - TrafficRecorder::headerSize) / TrafficRecorder::recordSize);
+    valid = true;
+}
+
+TrafficRecord TrafficReplayer::getRecord(int index) const {
+    TrafficRecord record;
+    const uint8 *data = (const uint8 *)mappedFile.getData();
+    memcpy(&record, data + TrafficRecorder::headerSize + (int64)index * TrafficRecorder::recordSize, TrafficRecorder::recordSize);
+    return record;
+}
+
+void TrafficReplayer::replay(BlockComponent& component, LightpadEmulator& emulator, double speed, double timeoutMs) {
+    MessageManager *messageManager = MessageManager::getInstance();
+    double start = Time::getMillisecondCounterHiRes();
+    for (int i = 0; i < numRecords; i++) {
+        TrafficRecord record = getRecord(i);
+        if (speed>0) {
+            double due = start + (double)record.time / 1000.0 / speed;
+            while (Time::getMillisecondCounterHiRes()<due) {
+                messageManager->runDispatchLoopUntil(1);
+            }
+        }
+        switch (record.type) {
+            case TrafficRecord::sentMessage: {
+                uint32 command = (record.values[0] >> 26) & 0x3F;
+                uint32 subCommand = (record.values[0] >> 18) & 0xFF;
+                uint8 param1 = record.values[0] & 0xFF;
+                component.sendStampedMessage(command, subCommand, param1, record.values[1], record.values[2]);
+                break;
+            }
+            case TrafficRecord::touch: {
+                float x = record.getFloat(0);
+                float y = record.getFloat(1);
+                float z = record.getFloat(2);
+                if (record.flags & 1) emulator.touchStart(record.index, x, y, z);
+                else if (record.flags & 2) emulator.touchEnd(record.index, x, y, z);
+                else emulator.touchMove(record.index, x, y, z);
+                break;
+            }
+            case TrafficRecord::button:
+                emulator.pressButton(record.index!=0);
+                break;
+            default:
+                break;
+        }
+    }
+    double end = Time::getMillisecondCounterHiRes() + timeoutMs;
+    do {
+        messageManager->runDispatchLoopUntil(1);
+    } while ((component.numDrawingMessages()>0 || emulator.numPendingEvents()>0) && Time::getMillisecondCounterHiRes()<end);
+}
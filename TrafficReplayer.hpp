@@ -0,0 +1,42 @@
+//
+//  TrafficReplayer.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include <BlocksHeader.h>
+#include "TrafficRecorder.hpp"
+
+class BlockComponent;
+class LightpadEmulator;
+
+// Reads a capture of the TrafficRecorder and plays it back against the
+// emulator: the commands of the patch go through the component, the touches
+// and buttons come from the emulator. Transmitted, resent and received messages
+// are only read, the component and the emulator make their own.
+class TrafficReplayer
+{
+public:
+    TrafficReplayer (const juce::File& file);
+
+    bool isValid() const { return valid; }
+    // ms since 1970
+    juce::int64 getStartTime() const { return startTime; }
+    int getNumRecords() const { return numRecords; }
+    TrafficRecord getRecord(int index) const;
+
+    // speed 1 keeps the recorded timing, 0 plays as fast as possible. Waits
+    // at most timeoutMs for the drawing to be acknowledged at the end.
+    void replay(BlockComponent& component, LightpadEmulator& emulator, double speed, double timeoutMs = 5000);
+
+private:
+    juce::MemoryMappedFile mappedFile;
+    bool valid;
+    juce::int64 startTime;
+    int numRecords;
+
+    JUCE_LEAK_DETECTOR (TrafficReplayer)
+};
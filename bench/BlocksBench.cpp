@@ -0,0 +1,785 @@
+//
+//  BlocksBench.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+//  Timing of the hot paths of the external with emulated Lightpads.
+//  Usage: blocks_bench
+//  Prints one JSON object per measurement. A wrong result is printed to
+//  stderr and the bench exits with 1.
+//
+
+#include <BlocksHeader.h>
+#include <cstdio>
+#include "PdStub.hpp"
+#include "../BlockFinder.hpp"
+#include "../LightpadEmulator.hpp"
+
+using namespace juce;
+
+// link, which keeps the messages instead of sending them
+class RecordingLink : public LightpadLink
+{
+public:
+    Array<Block::ProgramEventMessage> messages;
+
+    void sendProgramEvent(const Block::ProgramEventMessage& message) override {
+        messages.add(message);
+    }
+};
+
+// latency, jitter and loss of a link to an emulated Lightpad, and the messages
+// per second and the messages which can wait for it (0 = unlimited)
+struct Link
+{
+    const char *name;
+    double latency;
+    double jitter;
+    double loss;
+    double bandwidth;
+    int bufferSize;
+};
+
+static const Link localLink = {"local", 0, 0, 0, 0, 0};
+static const Link usbLink = {"usb", 2, 0, 0, 0, 0};
+static const Link bluetoothLink = {"bluetooth", 15, 5, 0.02, 0, 0};
+static const Link slowLink = {"slow", 2, 0, 0, 500, 0};
+
+// a Lightpad emulated over a link and its component
+struct EmulatedPad
+{
+    EmulatedPad (const Link& link, int64 seed = 1) : emulator(seed), component(&emulator, "pad") {
+        emulator.setLatency(link.latency, link.jitter);
+        emulator.setLossRate(link.loss);
+        emulator.setBandwidth(link.bandwidth);
+        emulator.setLinkBufferSize(link.bufferSize);
+        emulator.setComponent(&component);
+    }
+
+    LightpadEmulator emulator;
+    BlockComponent component;
+};
+
+static int numFailedChecks = 0;
+
+// a wrong result: the bench goes on, but fails at the end
+static void check(bool condition, const char *bench, const String& what) {
+    if (condition) return;
+    numFailedChecks++;
+    fprintf(stderr, "check failed: %s: %s\n", bench, what.toRawUTF8());
+}
+
+static double nanoseconds(int64 ticks) {
+    return 1e9 * (double)ticks / (double)Time::getHighResolutionTicksPerSecond();
+}
+
+// false, if the messages are still not acknowledged after timeout ms
+static bool waitForEmulator(BlockComponent& component, LightpadEmulator& emulator, double timeout) {
+    double end = Time::getMillisecondCounterHiRes() + timeout;
+    do {
+        MessageManager::getInstance()->runDispatchLoopUntil(1);
+        if (component.numDrawingMessages()==0 && emulator.numPendingEvents()==0) return true;
+    } while (Time::getMillisecondCounterHiRes()<end);
+    return false;
+}
+
+// a pd message like "pad led 3 4 0xff0000"
+struct PdMessage
+{
+    t_symbol *selector;
+    Array<t_atom> atoms;
+};
+
+static PdMessage makeMessage(const String& text) {
+    PdMessage message;
+    message.selector = nullptr;
+    String rest = text;
+    while (rest.isNotEmpty()) {
+        String token = rest.upToFirstOccurrenceOf(" ", false, false);
+        rest = rest.fromFirstOccurrenceOf(" ", false, false);
+        if (message.selector==nullptr) {
+            message.selector = gensym(token.toRawUTF8());
+            continue;
+        }
+        t_atom atom;
+        if (token.containsOnly("0123456789.-")) {
+            SETFLOAT(&atom, token.getFloatValue());
+        } else {
+            SETSYMBOL(&atom, gensym(token.toRawUTF8()));
+        }
+        message.atoms.add(atom);
+    }
+    return message;
+}
+
+static void benchParse() {
+    BlockFinder finder;
+    LightpadEmulator emulator;
+    BlockComponent *component = new BlockComponent(&emulator, "pad");
+    emulator.setComponent(component);
+    finder.addComponent(component);
+
+    const char *commands[][2] = {
+        {"led", "pad led 3 4 0xff0000"},
+        {"rect", "pad rect 2 2 5 5 0x00ff00"},
+        {"circle", "pad circle 8 8 4 0x0000ff"},
+        {"fader", "pad fader 2 0.5"},
+        {"mixer", "pad mixer fader 3 0.25"},
+        {"color", "pad color 0xff0000 0x00ff00 0x0000ff"},
+        {"unknown_block", "nopad led 1 1 0xff0000"}
+    };
+    const int numOps = 20000;
+    for (auto& command : commands) {
+        PdMessage message = makeMessage(command[1]);
+        int64 ticks = 0;
+        for (int i = 0; i < numOps; i++) {
+            // doBlockCommand may shift the atoms
+            Array<t_atom> atoms = message.atoms;
+            int64 start = Time::getHighResolutionTicks();
+            finder.doBlockCommand(message.selector, atoms.size(), atoms.getRawDataPointer());
+            ticks += Time::getHighResolutionTicks() - start;
+            if (i % 64 == 63) {
+                // acknowledge, so the messages don't pile up
+                emulator.processEvents();
+                emulator.processEvents();
+            }
+        }
+        printf("{\"bench\": \"parse\", \"command\": \"%s\", \"ops\": %d, \"ns_per_op\": %.1f}\n",
+               command[0], numOps, nanoseconds(ticks) / numOps);
+    }
+}
+
+// the same command to 8 Lightpads: a message per block, to all and to a group
+static void benchBroadcast() {
+    const int numBlocks = 8;
+    BlockFinder finder;
+    OwnedArray<LightpadEmulator> emulators;
+    Array<BlockComponent*> components;
+    String members;
+    for (int b = 0; b < numBlocks; b++) {
+        LightpadEmulator *emulator = emulators.add(new LightpadEmulator());
+        BlockComponent *component = new BlockComponent(emulator, "pad" + String(b + 1));
+        components.add(component);
+        emulator->setComponent(component);
+        finder.addComponent(component);
+        members += " pad" + String(b + 1);
+    }
+    PdMessage group = makeMessage("group stage" + members);
+    finder.doBlockCommand(group.selector, group.atoms.size(), group.atoms.getRawDataPointer());
+
+    const char *commands[] = {"color 0xff0000 0x00ff00 0x0000ff", "rect 2 2 5 5 0x00ff00", "clear"};
+    const char *targets[] = {"each", "all", "stage"};
+    const int numOps = 2000;
+    for (auto command : commands) {
+        for (auto target : targets) {
+            Array<PdMessage> messages;
+            if (String(target)=="each") {
+                for (int b = 0; b < numBlocks; b++) {
+                    messages.add(makeMessage("pad" + String(b + 1) + " " + command));
+                }
+            } else {
+                messages.add(makeMessage(String(target) + " " + command));
+            }
+            int64 ticks = 0;
+            for (int i = 0; i < numOps; i++) {
+                int64 start = Time::getHighResolutionTicks();
+                for (auto& message : messages) {
+                    Array<t_atom> atoms = message.atoms;
+                    finder.doBlockCommand(message.selector, atoms.size(), atoms.getRawDataPointer());
+                }
+                ticks += Time::getHighResolutionTicks() - start;
+                if (i % 16 == 15) {
+                    // acknowledge, so the messages don't pile up
+                    for (auto emulator : emulators) {
+                        emulator->processEvents();
+                        emulator->processEvents();
+                    }
+                }
+            }
+            printf("{\"bench\": \"broadcast\", \"command\": \"%s\", \"target\": \"%s\", \"blocks\": %d, \"ns_per_fanout\": %.1f}\n",
+                   String(command).upToFirstOccurrenceOf(" ", false, false).toRawUTF8(), target, numBlocks, nanoseconds(ticks) / numOps);
+            // every block got the command
+            for (int b = 0; b < numBlocks; b++) {
+                BlockComponent *component = components[b];
+                bool acknowledged = waitForEmulator(*component, *emulators[b], 1000);
+                check(acknowledged && emulators[b]->getDisplayedFrame()==component->ledFrame, "broadcast",
+                      String(target) + " " + command + ": " + *component->pdName + " shows other leds");
+            }
+        }
+    }
+}
+
+static void benchSendAck() {
+    RecordingLink link;
+    BlockComponent component(&link, "pad");
+    const int numBatches = 100;
+    int64 sendTicks = 0;
+    int64 ackTicks = 0;
+    for (int batch = 0; batch < numBatches; batch++) {
+        // as many as can be in flight, then their echos
+        for (int first = 0; first < 225; first += BlockComponent::maxInFlight) {
+            link.messages.clearQuick();
+            int64 start = Time::getHighResolutionTicks();
+            for (int ledNr = first; ledNr < jmin(225, first + BlockComponent::maxInFlight); ledNr++) {
+                component.sendStampedMessage(4, ledNr, 0, 0, 0xffff0000);
+            }
+            sendTicks += Time::getHighResolutionTicks() - start;
+            start = Time::getHighResolutionTicks();
+            for (auto& message : link.messages) {
+                component.receiveProgramEvent(message);
+            }
+            ackTicks += Time::getHighResolutionTicks() - start;
+        }
+    }
+    int numOps = numBatches * 225;
+    printf("{\"bench\": \"send\", \"ops\": %d, \"ns_per_op\": %.1f}\n", numOps, nanoseconds(sendTicks) / numOps);
+    printf("{\"bench\": \"ack\", \"ops\": %d, \"ns_per_op\": %.1f}\n", numOps, nanoseconds(ackTicks) / numOps);
+}
+
+static void benchRetransmitScan() {
+    int sizes[] = {16, 64, 256, 1024};
+    for (int size : sizes) {
+        RecordingLink link;
+        BlockComponent component(&link, "pad");
+        // straight into the messages waiting for their echo (sendStampedMessage
+        // tracks at most maxTracked), different command / subcommand, so every one is kept
+        for (int i = 0; i < size; i++) {
+            Block::ProgramEventMessage message;
+            uint32 millis = (Time::getMillisecondCounter() & 0x3FF) << 8;
+            message.values[0] = (int32)(((uint32)(i / 256) << 26) + ((uint32)(i % 256) << 18) + millis);
+            message.values[1] = 0;
+            message.values[2] = 0;
+            component.addMessageToCheck(&message);
+        }
+        component.rwLock->enterRead();
+        int inFlight = component.messageSet->size();
+        component.rwLock->exitRead();
+        // nothing to resend yet
+        const int numScans = 200;
+        int64 start = Time::getHighResolutionTicks();
+        for (int i = 0; i < numScans; i++) {
+            component.checkResends();
+        }
+        double scanNs = nanoseconds(Time::getHighResolutionTicks() - start) / numScans;
+        // everything is resent
+        const int numResends = 5;
+        int64 ticks = 0;
+        for (int i = 0; i < numResends; i++) {
+            Time::waitForMillisecondCounter(Time::getMillisecondCounter() + 110);
+            start = Time::getHighResolutionTicks();
+            component.checkResends();
+            ticks += Time::getHighResolutionTicks() - start;
+        }
+        printf("{\"bench\": \"retransmit_scan\", \"in_flight\": %d, \"ns_per_scan\": %.1f, \"ns_per_resend_scan\": %.1f}\n",
+               inFlight, scanNs, nanoseconds(ticks) / numResends);
+    }
+}
+
+static void benchTouch() {
+    const char *modes[] = {"xyz", "pads", "paint"};
+    const int numOps = 100000;
+    for (auto mode : modes) {
+        RecordingLink link;
+        BlockComponent component(&link, "pad");
+        component.setLightpadMode(mode);
+        component.setGridSize(3);
+        int numMessages = pdStubNumOutletMessages;
+        TouchSurface::Touch touch = {};
+        int64 start = Time::getHighResolutionTicks();
+        for (int i = 0; i < numOps; i++) {
+            touch.index = i % 4;
+            touch.x = (float)(i % 200) / 100.0f;
+            touch.y = (float)(i % 150) / 75.0f;
+            touch.z = 0.5f;
+            touch.startX = 1.0f;
+            touch.startY = 1.0f;
+            touch.isTouchStart = i % 50 == 0;
+            touch.isTouchEnd = i % 50 == 49;
+            component.receiveTouch(touch);
+        }
+        double ns = nanoseconds(Time::getHighResolutionTicks() - start) / numOps;
+        printf("{\"bench\": \"touch\", \"mode\": \"%s\", \"ops\": %d, \"ns_per_op\": %.1f, \"outlet_messages\": %d}\n",
+               mode, numOps, ns, pdStubNumOutletMessages - numMessages);
+    }
+}
+
+static LedFrame makeFrame(const String& workload, int f) {
+    LedFrame frame;
+    if (workload=="solid") {
+        frame.fillRect(0, 0, 15, 15, f % 2 ? 0xff0000 : 0x0000ff);
+    } else if (workload=="bars") {
+        for (int i = 0; i < 5; i++) {
+            int value = 1 + (f * (i + 1) / 3 + i * 4) % 15;
+            frame.fillRect(i * 3, 15 - value, 2, value, 0x00ff00);
+        }
+    } else if (workload=="sprite") {
+        frame.fillRect(0, 0, 15, 15, 0x000080);
+        frame.fillRect(f % 13, (f / 2) % 13, 3, 3, 0xffffff);
+    } else {
+        Random random(f);
+        for (int i = 0; i < 225; i++) {
+            frame.drawLED(i, (uint32)random.nextInt() & 0x00ffffff);
+        }
+    }
+    return frame;
+}
+
+static void benchFrames() {
+    const Link links[] = {localLink, usbLink, bluetoothLink};
+    const char *workloads[] = {"solid", "bars", "sprite", "noise"};
+    const int numFrames = 30;
+    for (auto& link : links) {
+        for (auto workload : workloads) {
+            EmulatedPad pad(link);
+            LightpadEmulator& emulator = pad.emulator;
+            BlockComponent& component = pad.component;
+            component.setLightpadMode("paint");
+            waitForEmulator(component, emulator, 1000);
+
+            int numMessages = emulator.numReceived;
+            double total = 0;
+            double maximum = 0;
+            int numCorrect = 0;
+            int numTimeouts = 0;
+            for (int f = 0; f < numFrames; f++) {
+                double start = Time::getMillisecondCounterHiRes();
+                component.uploadFrame(makeFrame(workload, f));
+                bool acknowledged = waitForEmulator(component, emulator, 5000);
+                if (!acknowledged) numTimeouts++;
+                double time = Time::getMillisecondCounterHiRes() - start;
+                total += time;
+                maximum = jmax(maximum, time);
+                bool correct = emulator.getDisplayedFrame()==makeFrame(workload, f);
+                if (correct) numCorrect++;
+                // a frame, which is still on its way, isn't wrong yet
+                check(correct || !acknowledged, "frame", String(link.name) + " " + workload + ": frame " + String(f) + " is wrong");
+            }
+            printf("{\"bench\": \"frame\", \"link\": \"%s\", \"workload\": \"%s\", \"frames\": %d, \"ms_per_frame\": %.2f, "
+                   "\"max_ms\": %.2f, \"messages_per_frame\": %.1f, \"correct_frames\": %d, \"timeouts\": %d}\n",
+                   link.name, workload, numFrames, total / numFrames, maximum,
+                   (double)(emulator.numReceived - numMessages) / numFrames, numCorrect, numTimeouts);
+        }
+    }
+}
+
+// false, if not all messages are acknowledged after timeout ms
+static bool waitForAllMessages(BlockComponent& component, LightpadEmulator& emulator, double timeout) {
+    double end = Time::getMillisecondCounterHiRes() + timeout;
+    do {
+        MessageManager::getInstance()->runDispatchLoopUntil(1);
+        component.rwLock->enterRead();
+        int numMessages = component.messageSet->size();
+        component.rwLock->exitRead();
+        numMessages += component.numQueuedMessages();
+        // and the verified drawing, which isn't checked yet
+        numMessages += component.numDrawingMessages();
+        if (numMessages==0 && emulator.numPendingEvents()==0) return true;
+    } while (Time::getMillisecondCounterHiRes()<end);
+    return false;
+}
+
+// a fader change during the upload of a frame over a link with limited bandwidth:
+// the time until the fader is set on the block and until the frame is shown
+static void benchPriority() {
+    const char *workloads[] = {"sprite", "noise"};
+    for (auto workload : workloads) {
+        EmulatedPad pad(slowLink);
+        LightpadEmulator& emulator = pad.emulator;
+        BlockComponent& component = pad.component;
+        component.setLightpadMode("faders");
+        waitForAllMessages(component, emulator, 1000);
+
+        double start = Time::getMillisecondCounterHiRes();
+        component.uploadFrame(makeFrame(workload, 1));
+        component.setFaderValue(1, 0.5f);
+        double faderTime = -1;
+        double end = start + 5000;
+        do {
+            MessageManager::getInstance()->runDispatchLoopUntil(1);
+            if (faderTime<0 && emulator.getHeapInt(102)==500000) {
+                faderTime = Time::getMillisecondCounterHiRes() - start;
+            }
+        } while (component.numDrawingMessages()>0 && Time::getMillisecondCounterHiRes()<end);
+        double frameTime = Time::getMillisecondCounterHiRes() - start;
+        printf("{\"bench\": \"priority\", \"workload\": \"%s\", \"messages_per_s\": 500, \"fader_ms\": %.2f, \"frame_ms\": %.2f}\n",
+               workload, faderTime, frameTime);
+        check(faderTime>=0 && faderTime<=frameTime, "priority", String(workload) + ": the fader isn't set before the frame");
+        check(emulator.getDisplayedFrame()==makeFrame(workload, 1), "priority", String(workload) + ": the frame is wrong");
+    }
+}
+
+// fader changes faster than the link: the messages on the link and the time
+// from the last change until it is set on the block
+static void benchCoalesce() {
+    const Link link = {"bluetooth", 15, 5, 0, 500, 0};
+    EmulatedPad pad(link);
+    LightpadEmulator& emulator = pad.emulator;
+    BlockComponent& component = pad.component;
+    component.setLightpadMode("faders");
+    waitForAllMessages(component, emulator, 1000);
+
+    const int numChanges = 200;
+    int numMessages = emulator.numReceived;
+    for (int i = 1; i <= numChanges; i++) {
+        component.setFaderValue(1, (float)i / numChanges);
+        MessageManager::getInstance()->runDispatchLoopUntil(1);
+    }
+    double start = Time::getMillisecondCounterHiRes();
+    while (emulator.getHeapInt(102)!=1000000 && Time::getMillisecondCounterHiRes() - start<5000) {
+        MessageManager::getInstance()->runDispatchLoopUntil(1);
+    }
+    double time = Time::getMillisecondCounterHiRes() - start;
+    waitForAllMessages(component, emulator, 1000);
+    printf("{\"bench\": \"coalesce\", \"changes\": %d, \"messages\": %d, \"coalesced\": %lld, \"last_change_ms\": %.2f}\n",
+           numChanges, emulator.numReceived - numMessages, (long long)component.stats.coalesced.load(), time);
+    check(emulator.getHeapInt(102)==1000000, "coalesce", "the fader has not the last value");
+}
+
+// frames over a bluetooth like link, which loses the messages overrunning its
+// buffer: without a limit and with the adaptive rate
+static void benchPacing() {
+    double rates[] = {0, BlockComponent::bluetoothRate};
+    const char *workloads[] = {"bars", "noise"};
+    const int numFrames = 10;
+    const Link link = {"bluetooth", 15, 5, 0, 300, 32};
+    for (double maxRate : rates) {
+        for (auto workload : workloads) {
+            EmulatedPad pad(link);
+            LightpadEmulator& emulator = pad.emulator;
+            BlockComponent& component = pad.component;
+            component.setMaxRate(maxRate);
+            component.setLightpadMode("paint");
+            waitForAllMessages(component, emulator, 1000);
+
+            int numMessages = emulator.numReceived;
+            int numLost = emulator.numLost;
+            double total = 0;
+            int numCorrect = 0;
+            int numTimeouts = 0;
+            for (int f = 0; f < numFrames; f++) {
+                double start = Time::getMillisecondCounterHiRes();
+                component.uploadFrame(makeFrame(workload, f));
+                bool acknowledged = waitForAllMessages(component, emulator, 5000);
+                if (!acknowledged) numTimeouts++;
+                total += Time::getMillisecondCounterHiRes() - start;
+                bool correct = emulator.getDisplayedFrame()==makeFrame(workload, f);
+                if (correct) numCorrect++;
+                check(correct || !acknowledged, "pacing", String(workload) + ": frame " + String(f) + " is wrong");
+            }
+            printf("{\"bench\": \"pacing\", \"max_rate\": %.0f, \"workload\": \"%s\", \"ms_per_frame\": %.2f, "
+                   "\"messages_per_frame\": %.1f, \"lost_per_frame\": %.1f, \"rate\": %.0f, \"correct_frames\": %d, \"timeouts\": %d}\n",
+                   maxRate, workload, total / numFrames, (double)(emulator.numReceived - numMessages) / numFrames,
+                   (double)(emulator.numLost - numLost) / numFrames, component.rate, numCorrect, numTimeouts);
+        }
+    }
+}
+
+// frame uploads with an echo per message and with verified drawing (no echos,
+// one checksum round trip per frame): messages in both directions and the time per frame
+static void benchVerify() {
+    const Link links[] = {usbLink, bluetoothLink};
+    const char *workloads[] = {"bars", "noise"};
+    const int numFrames = 20;
+    for (auto& link : links) {
+        for (int verify = 0; verify < 2; verify++) {
+            for (auto workload : workloads) {
+                EmulatedPad pad(link);
+                LightpadEmulator& emulator = pad.emulator;
+                BlockComponent& component = pad.component;
+                component.setLightpadMode("paint");
+                component.setDrawingVerification(verify==1);
+                waitForAllMessages(component, emulator, 1000);
+
+                int numMessages = emulator.numReceived;
+                int numReplies = emulator.numSent;
+                double total = 0;
+                int numCorrect = 0;
+                int numTimeouts = 0;
+                for (int f = 0; f < numFrames; f++) {
+                    double start = Time::getMillisecondCounterHiRes();
+                    component.uploadFrame(makeFrame(workload, f));
+                    bool acknowledged = waitForAllMessages(component, emulator, 5000);
+                    if (!acknowledged) numTimeouts++;
+                    total += Time::getMillisecondCounterHiRes() - start;
+                    bool correct = emulator.getDisplayedFrame()==makeFrame(workload, f);
+                    if (correct) numCorrect++;
+                    // with verify: the checksums matched, but a row is wrong
+                    check(correct || !acknowledged, "verify", String(link.name) + " " + workload + (verify ? " verified" : "")
+                          + ": frame " + String(f) + " is wrong");
+                }
+                printf("{\"bench\": \"verify\", \"link\": \"%s\", \"verify\": %s, \"workload\": \"%s\", \"ms_per_frame\": %.2f, "
+                       "\"messages_per_frame\": %.1f, \"replies_per_frame\": %.1f, \"repaired_rows\": %lld, \"correct_frames\": %d, \"timeouts\": %d}\n",
+                       link.name, verify ? "true" : "false", workload, total / numFrames,
+                       (double)(emulator.numReceived - numMessages) / numFrames, (double)(emulator.numSent - numReplies) / numFrames,
+                       (long long)component.stats.rowsRepaired.load(), numCorrect, numTimeouts);
+            }
+        }
+    }
+}
+
+// an animation at 30 frames per second over a link with limited bandwidth, with
+// and without dropping the stale frames: the time from the last frame until it is shown
+static void benchStaleFrames() {
+    const char *workloads[] = {"sprite", "noise"};
+    const int numFrames = 30;
+    for (int drop = 0; drop < 2; drop++) {
+        for (auto workload : workloads) {
+            EmulatedPad pad(slowLink);
+            LightpadEmulator& emulator = pad.emulator;
+            BlockComponent& component = pad.component;
+            component.setLightpadMode("paint");
+            component.dropStaleFrames = drop==1;
+            waitForAllMessages(component, emulator, 1000);
+
+            int numMessages = emulator.numReceived;
+            double start = Time::getMillisecondCounterHiRes();
+            for (int f = 0; f < numFrames; f++) {
+                component.uploadFrame(makeFrame(workload, f));
+                while (Time::getMillisecondCounterHiRes() - start<(f + 1) * 1000.0 / 30) {
+                    MessageManager::getInstance()->runDispatchLoopUntil(1);
+                }
+            }
+            double last = Time::getMillisecondCounterHiRes();
+            bool acknowledged = waitForAllMessages(component, emulator, 10000);
+            double time = Time::getMillisecondCounterHiRes() - last;
+            bool correct = emulator.getDisplayedFrame()==makeFrame(workload, numFrames - 1);
+            printf("{\"bench\": \"staleframes\", \"drop\": %s, \"workload\": \"%s\", \"frames\": %d, \"dropped\": %lld, "
+                   "\"messages\": %d, \"last_frame_ms\": %.2f, \"correct\": %s, \"timeout\": %s}\n",
+                   drop ? "true" : "false", workload, numFrames, (long long)component.stats.framesDropped.load(),
+                   emulator.numReceived - numMessages, time, correct ? "true" : "false", acknowledged ? "false" : "true");
+            check(correct || !acknowledged, "staleframes", String(workload) + ": the last frame is wrong");
+        }
+    }
+}
+
+// the link drops every message for 2 s during an animation: the messages waiting
+// for their echo, the messages sent meanwhile and the time until the block is correct again
+static void benchStall() {
+    const char *workloads[] = {"bars", "noise"};
+    for (auto workload : workloads) {
+        EmulatedPad pad(usbLink);
+        LightpadEmulator& emulator = pad.emulator;
+        BlockComponent& component = pad.component;
+        component.setLightpadMode("paint");
+        component.uploadFrame(makeFrame(workload, 0));
+        waitForAllMessages(component, emulator, 1000);
+
+        emulator.setLossRate(1);
+        int64 numSent = component.stats.messagesSent.load();
+        int maxInFlight = 0;
+        bool stalled = false;
+        double start = Time::getMillisecondCounterHiRes();
+        for (int f = 1; Time::getMillisecondCounterHiRes() - start<2000; f++) {
+            component.uploadFrame(makeFrame(workload, f));
+            component.setFaderValue(1, (float)(f % 10) / 10);
+            double frameStart = Time::getMillisecondCounterHiRes();
+            while (Time::getMillisecondCounterHiRes() - frameStart<33) {
+                MessageManager::getInstance()->runDispatchLoopUntil(1);
+                component.rwLock->enterRead();
+                maxInFlight = jmax(maxInFlight, component.messageSet->size());
+                component.rwLock->exitRead();
+                stalled = stalled || component.linkHealth==BlockComponent::stalledLink;
+            }
+        }
+        numSent = component.stats.messagesSent.load() - numSent;
+
+        emulator.setLossRate(0);
+        start = Time::getMillisecondCounterHiRes();
+        bool acknowledged = waitForAllMessages(component, emulator, 5000);
+        double time = Time::getMillisecondCounterHiRes() - start;
+        bool correct = emulator.getDisplayedFrame()==component.ledFrame;
+        printf("{\"bench\": \"stall\", \"workload\": \"%s\", \"stalled\": %s, \"max_in_flight\": %d, \"messages_during_outage\": %lld, "
+               "\"recovery_ms\": %.2f, \"correct\": %s, \"timeout\": %s}\n",
+               workload, stalled ? "true" : "false", maxInFlight, (long long)numSent, time,
+               correct ? "true" : "false", acknowledged ? "false" : "true");
+        check(stalled, "stall", String(workload) + ": the link isn't stalled");
+        check(correct || !acknowledged, "stall", String(workload) + ": the frame after the outage is wrong");
+    }
+}
+
+// writes frames of a workload with runs of the same colour, as the FramePlayer reads them
+static int64 writeRunFrames(const File& file, const String& workload, int numFrames) {
+    file.deleteFile();
+    FileOutputStream stream(file);
+    uint8 header[FramePlayer::headerSize] = {'L', 'P', 'F', 'R', 1, 1, FramePlayer::runEncoding, 0};
+    stream.write(header, sizeof(header));
+    int64 size = sizeof(header);
+    for (int f = 0; f < numFrames; f++) {
+        LedFrame frame = makeFrame(workload, f);
+        int ledNr = 0;
+        while (ledNr < 225) {
+            uint32 colour = frame.getLED(ledNr);
+            int length = 1;
+            while (ledNr + length < 225 && length < 255 && frame.getLED(ledNr + length)==colour) length++;
+            uint8 run[4] = {(uint8)length, (uint8)(colour >> 16), (uint8)(colour >> 8), (uint8)colour};
+            stream.write(run, sizeof(run));
+            size += sizeof(run);
+            ledNr += length;
+        }
+    }
+    return size;
+}
+
+// a frame file played at 30 frames per second with dropped stale frames: the frames
+// shown and skipped by the player and the bytes of the file compared to r g b
+static void benchPlayback() {
+    const Link links[] = {usbLink, slowLink};
+    const char *workloads[] = {"sprite", "noise"};
+    const int numFrames = 60;
+    File file = File::getCurrentWorkingDirectory().getChildFile("bench_frames.lpfr");
+    for (auto& link : links) {
+        for (auto workload : workloads) {
+            int64 fileSize = writeRunFrames(file, workload, numFrames);
+            EmulatedPad pad(link);
+            LightpadEmulator& emulator = pad.emulator;
+            BlockComponent& component = pad.component;
+            component.setLightpadMode("paint");
+            component.dropStaleFrames = true;
+            waitForAllMessages(component, emulator, 1000);
+
+            Array<BlockComponent*> components;
+            components.add(&component);
+            FramePlayer player("pad", file, components);
+            int numMessages = emulator.numReceived;
+            double start = Time::getMillisecondCounterHiRes();
+            player.start(30);
+            while (player.isPlaying()) {
+                MessageManager::getInstance()->runDispatchLoopUntil(1);
+            }
+            double last = Time::getMillisecondCounterHiRes();
+            bool acknowledged = waitForAllMessages(component, emulator, 10000);
+            double time = Time::getMillisecondCounterHiRes() - last;
+            bool correct = emulator.getDisplayedFrame()==makeFrame(workload, numFrames - 1);
+            printf("{\"bench\": \"playback\", \"link\": \"%s\", \"workload\": \"%s\", \"frames\": %d, \"file_bytes\": %lld, \"rgb_bytes\": %d, "
+                   "\"play_ms\": %.1f, \"shown\": %d, \"skipped\": %d, \"dropped\": %lld, \"messages\": %d, \"last_frame_ms\": %.2f, "
+                   "\"correct\": %s, \"timeout\": %s}\n",
+                   link.name, workload, numFrames, (long long)fileSize, numFrames * 675, last - start,
+                   player.framesShown, player.framesSkipped, (long long)component.stats.framesDropped.load(),
+                   emulator.numReceived - numMessages, time, correct ? "true" : "false", acknowledged ? "false" : "true");
+            check(player.framesShown + player.framesSkipped==numFrames, "playback",
+                  String(link.name) + " " + workload + ": frames are neither shown nor skipped");
+            check(correct || !acknowledged, "playback", String(link.name) + " " + workload + ": the last frame is wrong");
+        }
+    }
+    file.deleteFile();
+}
+
+// a song with its mode, pad colours, faders and drawing, as a patch sends it. The
+// songs differ in the mode, 3 pad colours, a fader and the position of a sprite
+static void setSong(BlockComponent& component, int song) {
+    OwnedArray<LEDColour> colours;
+    for (int i = 0; i < 25; i++) {
+        colours.add(new LEDColour(0xff000000 + (uint32)(i < 3 && song==1 ? 0x00ff00 : 0x200000 * (i % 8))));
+    }
+    component.setLightpadMode(song==0 ? "mixer" : "paint");
+    component.setGridSize(4);
+    component.setColors(&colours);
+    for (int i = 0; i < 4; i++) {
+        component.setMixerFaderValue(i, i==0 ? 0.3f * (float)song : 0.5f);
+    }
+    component.clearScreen();
+    component.uploadFrame(makeFrame("sprite", song * 8));
+}
+
+// switching between two songs: all messages of the song again or a recalled scene,
+// the messages and the time until the block shows the song
+static void benchScenes() {
+    const Link links[] = {usbLink, bluetoothLink};
+    const int numSwitches = 10;
+    for (auto& link : links) {
+        for (int recall = 0; recall < 2; recall++) {
+            EmulatedPad pad(link);
+            LightpadEmulator& emulator = pad.emulator;
+            BlockComponent& component = pad.component;
+            for (int song = 0; song < 2; song++) {
+                setSong(component, song);
+                component.storeScene(song);
+            }
+            waitForAllMessages(component, emulator, 5000);
+
+            int numMessages = emulator.numReceived;
+            double total = 0;
+            double maximum = 0;
+            int numCorrect = 0;
+            for (int i = 0; i < numSwitches; i++) {
+                int song = i % 2;
+                double start = Time::getMillisecondCounterHiRes();
+                if (recall) {
+                    component.recallScene(song);
+                } else {
+                    setSong(component, song);
+                }
+                bool acknowledged = waitForAllMessages(component, emulator, 5000);
+                double time = Time::getMillisecondCounterHiRes() - start;
+                total += time;
+                maximum = jmax(maximum, time);
+                bool correct = emulator.getDisplayedFrame()==makeFrame("sprite", song * 8)
+                    && emulator.getHeapByte(0)==(song==0 ? mMixer : mPaint);
+                if (correct) numCorrect++;
+                check(correct || !acknowledged, "scene", String(link.name) + (recall ? " recall" : " resend")
+                      + ": song " + String(song) + " is wrong");
+            }
+            printf("{\"bench\": \"scene\", \"link\": \"%s\", \"switch\": \"%s\", \"switches\": %d, \"messages_per_switch\": %.1f, "
+                   "\"ms_per_switch\": %.2f, \"max_ms\": %.2f, \"correct\": %d}\n",
+                   link.name, recall ? "recall" : "resend", numSwitches, (double)(emulator.numReceived - numMessages) / numSwitches,
+                   total / numSwitches, maximum, numCorrect);
+        }
+    }
+}
+
+// a Lightpad reconnects: the time until it shows the retained state again
+static void benchReconnect() {
+    const Link links[] = {localLink, usbLink, bluetoothLink};
+    const char *workloads[] = {"sprite", "noise"};
+    for (auto& link : links) {
+        for (auto workload : workloads) {
+            EmulatedPad pad(localLink);
+            LightpadEmulator& emulator = pad.emulator;
+            BlockComponent& component = pad.component;
+            component.setLightpadMode("paint");
+            component.setDoubleBuffering(true);
+            component.uploadFrame(makeFrame(workload, 3));
+            component.swapBuffers();
+            waitForAllMessages(component, emulator, 1000);
+            LedFrame shown = emulator.getDisplayedFrame();
+            BlockComponent::RetainedState state = component.retainState();
+
+            EmulatedPad reconnectedPad(link, 2);
+            LightpadEmulator& reconnected = reconnectedPad.emulator;
+            BlockComponent& restored = reconnectedPad.component;
+            double start = Time::getMillisecondCounterHiRes();
+            restored.restoreState(state);
+            bool acknowledged = waitForAllMessages(restored, reconnected, 5000);
+            double time = Time::getMillisecondCounterHiRes() - start;
+            bool correct = reconnected.getDisplayedFrame()==shown && reconnected.getHeapByte(0)==mPaint;
+            printf("{\"bench\": \"reconnect\", \"link\": \"%s\", \"workload\": \"%s\", \"ms_to_display\": %.2f, "
+                   "\"messages\": %d, \"correct\": %s, \"timeout\": %s}\n",
+                   link.name, workload, time, reconnected.numReceived,
+                   correct ? "true" : "false", acknowledged ? "false" : "true");
+            check(shown==makeFrame(workload, 3), "reconnect", String(workload) + ": the frame before the dropout is wrong");
+            check(correct || !acknowledged, "reconnect", String(link.name) + " " + workload + ": the restored state is wrong");
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    ScopedJuceInitialiser_GUI platform;
+
+    benchParse();
+    benchBroadcast();
+    benchSendAck();
+    benchRetransmitScan();
+    benchTouch();
+    benchFrames();
+    benchPriority();
+    benchCoalesce();
+    benchPacing();
+    benchStaleFrames();
+    benchVerify();
+    benchStall();
+    benchPlayback();
+    benchScenes();
+    benchReconnect();
+    return numFailedChecks>0 ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+//
+//  FrameEncodingBench.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+//  Bytes per frame of the frame encodings for a corpus of animations.
+//  Usage: encoding_bench [raw frames file]
+//  A frames file has 225 x 3 bytes (r, g, b) per frame, row by row.
+//  Prints one JSON object per corpus, color mode and encoding.
+//
+
+#include <BlocksHeader.h>
+#include <cstdio>
+#include "../FrameEncoder.hpp"
+
+using namespace juce;
+
+// payload of a ProgramEventMessage: 3 x 32 bit
+static const int bytesPerMessage = 12;
+
+static const uint32 palette[16] = {
+    0x000000, 0xffffff, 0xff0000, 0x00ff00, 0x0000ff, 0xffff00, 0x00ffff, 0xff00ff,
+    0x800000, 0x008000, 0x000080, 0x808000, 0x008080, 0x800080, 0x808080, 0xff8000
+};
+
+static uint32 nearestIndex(uint32 colour) {
+    int nearest = 0;
+    int minDistance = -1;
+    for (int i = 0; i < 16; i++) {
+        int red = (int)((colour >> 16) & 0xff) - (int)((palette[i] >> 16) & 0xff);
+        int green = (int)((colour >> 8) & 0xff) - (int)((palette[i] >> 8) & 0xff);
+        int blue = (int)(colour & 0xff) - (int)(palette[i] & 0xff);
+        int distance = red*red + green*green + blue*blue;
+        if (minDistance<0 || distance<minDistance) {
+            minDistance = distance;
+            nearest = i;
+        }
+    }
+    return (uint32)nearest;
+}
+
+struct Corpus
+{
+    String name;
+    Array<LedFrame> frames;
+};
+
+static Corpus makeSolid() {
+    Corpus corpus = {"solid", {}};
+    for (int f = 0; f < 200; f++) {
+        LedFrame frame;
+        frame.fillRect(0, 0, 15, 15, palette[1 + (f / 10) % 15]);
+        corpus.frames.add(frame);
+    }
+    return corpus;
+}
+
+static Corpus makeBars() {
+    // 5 faders moving up and down
+    Corpus corpus = {"bars", {}};
+    for (int f = 0; f < 200; f++) {
+        LedFrame frame;
+        for (int i = 0; i < 5; i++) {
+            int value = 1 + (f * (i + 1) / 3 + i * 4) % 15;
+            frame.fillRect(i * 3, 15 - value, 2, value, palette[2 + i]);
+        }
+        corpus.frames.add(frame);
+    }
+    return corpus;
+}
+
+static Corpus makeMeter() {
+    // horizontal level meter, green / yellow / red
+    Corpus corpus = {"meter", {}};
+    Random random(1);
+    for (int f = 0; f < 200; f++) {
+        LedFrame frame;
+        for (int y = 0; y < 15; y++) {
+            int level = random.nextInt(16);
+            frame.fillRect(0, y, jmin(level, 9), 1, 0x00ff00);
+            if (level>9) frame.fillRect(9, y, jmin(level, 12) - 9, 1, 0xffff00);
+            if (level>12) frame.fillRect(12, y, level - 12, 1, 0xff0000);
+        }
+        corpus.frames.add(frame);
+    }
+    return corpus;
+}
+
+static Corpus makeSprite() {
+    // small sprite moving over a dark background
+    Corpus corpus = {"sprite", {}};
+    for (int f = 0; f < 200; f++) {
+        LedFrame frame;
+        frame.fillRect(0, 0, 15, 15, 0x000080);
+        frame.fillRect(f % 13, (f / 2) % 13, 3, 3, 0xffffff);
+        corpus.frames.add(frame);
+    }
+    return corpus;
+}
+
+static Corpus makeStripes() {
+    // scrolling diagonal stripes
+    Corpus corpus = {"stripes", {}};
+    for (int f = 0; f < 200; f++) {
+        LedFrame frame;
+        for (int y = 0; y < 15; y++) {
+            for (int x = 0; x < 15; x++) {
+                frame.setPixel(x, y, ((x + y + f) / 3) % 2 ? 0xff00ff : 0x000000);
+            }
+        }
+        corpus.frames.add(frame);
+    }
+    return corpus;
+}
+
+static Corpus makeNoise() {
+    Corpus corpus = {"noise", {}};
+    Random random(2);
+    for (int f = 0; f < 200; f++) {
+        LedFrame frame;
+        for (int i = 0; i < 225; i++) {
+            frame.drawLED(i, palette[random.nextInt(16)]);
+        }
+        corpus.frames.add(frame);
+    }
+    return corpus;
+}
+
+static bool loadCorpus(const String& path, Corpus& corpus) {
+    MemoryBlock data;
+    if (!File(path).loadFileAsData(data)) return false;
+    const uint8 *bytes = (const uint8 *)data.getData();
+    int numFrames = (int)(data.getSize() / 675);
+    corpus.name = File(path).getFileName();
+    for (int f = 0; f < numFrames; f++) {
+        LedFrame frame;
+        for (int i = 0; i < 225; i++) {
+            const uint8 *rgb = bytes + f * 675 + i * 3;
+            frame.drawLED(i, ((uint32)rgb[0] << 16) + ((uint32)rgb[1] << 8) + rgb[2]);
+        }
+        corpus.frames.add(frame);
+    }
+    return numFrames>0;
+}
+
+static void runCorpus(const Corpus& corpus, bool indexed, FrameEncoder::Encoding encoding) {
+    LedFrame current;
+    current.setIndexed(indexed);
+    int64 numMessages = 0;
+    int64 ticks = 0;
+    for (auto& source : corpus.frames) {
+        LedFrame target;
+        target.setIndexed(indexed);
+        for (int i = 0; i < 225; i++) {
+            target.drawLED(i, indexed ? nearestIndex(source.getLED(i)) : source.getLED(i));
+        }
+        Array<LightpadCommand> commands;
+        int64 start = Time::getHighResolutionTicks();
+        FrameEncoder::encode(current, target, commands, encoding);
+        ticks += Time::getHighResolutionTicks() - start;
+        numMessages += commands.size();
+        current = target;
+    }
+    double numFrames = jmax(1, corpus.frames.size());
+    double microseconds = 1e6 * (double)ticks / (double)Time::getHighResolutionTicksPerSecond();
+    printf("{\"bench\": \"encoding\", \"corpus\": \"%s\", \"mode\": \"%s\", \"encoding\": \"%s\", \"frames\": %d, "
+           "\"messages_per_frame\": %.2f, \"bytes_per_frame\": %.1f, \"us_per_frame\": %.2f}\n",
+           corpus.name.toRawUTF8(), indexed ? "indexed" : "rgb", FrameEncoder::getName(encoding), corpus.frames.size(),
+           numMessages / numFrames, numMessages * bytesPerMessage / numFrames, microseconds / numFrames);
+}
+
+int main(int argc, char *argv[]) {
+    Array<Corpus> corpora;
+    if (argc>1) {
+        Corpus corpus;
+        if (!loadCorpus(argv[1], corpus)) {
+            fprintf(stderr, "can't read frames from %s\n", argv[1]);
+            return 1;
+        }
+        corpora.add(corpus);
+    } else {
+        corpora.add(makeSolid());
+        corpora.add(makeBars());
+        corpora.add(makeMeter());
+        corpora.add(makeSprite());
+        corpora.add(makeStripes());
+        corpora.add(makeNoise());
+    }
+
+    FrameEncoder::Encoding encodings[] = {
+        FrameEncoder::pixelEncoding, FrameEncoder::runEncoding, FrameEncoder::frameEncoding, FrameEncoder::autoEncoding
+    };
+    for (auto& corpus : corpora) {
+        for (int indexed = 0; indexed < 2; indexed++) {
+            for (auto encoding : encodings) {
+                runCorpus(corpus, indexed==1, encoding);
+            }
+        }
+    }
+    return 0;
+}
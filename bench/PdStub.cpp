@@ -0,0 +1,47 @@
+//
+//  PdStub.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+//  The few Pd functions used by the external, so the benchmarks run without
+//  Pure Data. Outlets only count the messages, the console is quiet.
+//
+
+#include "PdStub.hpp"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+
+static std::map<std::string, t_symbol*> symbols;
+
+int pdStubNumOutletMessages = 0;
+int pdStubNumErrors = 0;
+
+t_symbol *gensym(const char *s) {
+    auto found = symbols.find(s);
+    if (found!=symbols.end()) return found->second;
+    t_symbol *symbol = new t_symbol();
+    symbol->s_name = strdup(s);
+    symbol->s_thing = nullptr;
+    symbol->s_next = nullptr;
+    symbols[s] = symbol;
+    return symbol;
+}
+
+void post(const char *fmt, ...) {
+}
+
+void error(const char *fmt, ...) {
+    pdStubNumErrors++;
+}
+
+void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv) {
+    pdStubNumOutletMessages++;
+}
+
+void outlet_bang(t_outlet *x) {
+    pdStubNumOutletMessages++;
+}
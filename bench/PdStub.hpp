@@ -0,0 +1,14 @@
+//
+//  PdStub.hpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+
+#pragma once
+
+#include "../m_pd.h"
+
+// messages sent to any outlet and errors posted, since the start
+extern int pdStubNumOutletMessages;
+extern int pdStubNumErrors;
@@ -0,0 +1,98 @@
+//
+//  TrafficReplay.cpp
+//  Blocks
+//
+//  Created by agent on 19.10.26.
+//
+//  Plays a capture of '[blockname] record [file]' back against the emulator.
+//  Usage: traffic_replay [file] [speed] [latency ms] [loss rate]
+//         traffic_replay [file] dump
+//  Prints the summary (or every record) as JSON.
+//
+
+#include <BlocksHeader.h>
+#include <cstdio>
+#include "PdStub.hpp"
+#include "../BlockComponent.hpp"
+#include "../LightpadEmulator.hpp"
+#include "../TrafficReplayer.hpp"
+
+using namespace juce;
+
+static void dump(const TrafficReplayer& replayer) {
+    for (int i = 0; i < replayer.getNumRecords(); i++) {
+        TrafficRecord record = replayer.getRecord(i);
+        printf("{\"time_ms\": %.3f, \"type\": \"%s\", ", (double)record.time / 1000.0, TrafficRecord::getTypeName(record.type));
+        if (record.type==TrafficRecord::touch) {
+            const char *phase = (record.flags & 1) ? "start" : ((record.flags & 2) ? "end" : "move");
+            printf("\"index\": %d, \"phase\": \"%s\", \"x\": %.3f, \"y\": %.3f, \"z\": %.3f}\n",
+                   record.index, phase, record.getFloat(0), record.getFloat(1), record.getFloat(2));
+        } else if (record.type==TrafficRecord::button) {
+            printf("\"pressed\": %d}\n", record.index);
+        } else {
+            printf("\"command\": %u, \"subcommand\": %u, \"stamp\": %u, \"param1\": %u, \"param2\": %u, \"param3\": %u}\n",
+                   (record.values[0] >> 26) & 0x3F, (record.values[0] >> 18) & 0xFF, (record.values[0] >> 8) & 0x3FF,
+                   record.values[0] & 0xFF, record.values[1], record.values[2]);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc<2) {
+        fprintf(stderr, "usage: traffic_replay [file] [speed] [latency ms] [loss rate]\n       traffic_replay [file] dump\n");
+        return 1;
+    }
+    ScopedJuceInitialiser_GUI platform;
+
+    File file = File::getCurrentWorkingDirectory().getChildFile(argv[1]);
+    TrafficReplayer replayer(file);
+    if (!replayer.isValid()) {
+        fprintf(stderr, "%s is not a capture\n", argv[1]);
+        return 1;
+    }
+    if (argc>2 && String(argv[2])=="dump") {
+        dump(replayer);
+        return 0;
+    }
+    double speed = argc>2 ? String(argv[2]).getDoubleValue() : 1.0;
+    double latency = argc>3 ? String(argv[3]).getDoubleValue() : 0.0;
+    double loss = argc>4 ? String(argv[4]).getDoubleValue() : 0.0;
+
+    // the leds of the capture: every message sent to the block once, in order
+    LightpadEmulator reference;
+    int numRecords[TrafficRecord::numTypes] = {};
+    double recordedTime = 0;
+    for (int i = 0; i < replayer.getNumRecords(); i++) {
+        TrafficRecord record = replayer.getRecord(i);
+        if (record.type<TrafficRecord::numTypes) numRecords[record.type]++;
+        recordedTime = (double)record.time / 1000.0;
+        if (record.type==TrafficRecord::transmittedMessage) {
+            Block::ProgramEventMessage message;
+            for (int v = 0; v < 3; v++) {
+                message.values[v] = (int32)record.values[v];
+            }
+            reference.sendProgramEvent(message);
+            reference.processEvents();
+        }
+    }
+
+    LightpadEmulator emulator;
+    emulator.setLatency(latency);
+    emulator.setLossRate(loss);
+    BlockComponent component(&emulator, "replay");
+    emulator.setComponent(&component);
+
+    double start = Time::getMillisecondCounterHiRes();
+    replayer.replay(component, emulator, speed);
+    double replayTime = Time::getMillisecondCounterHiRes() - start;
+
+    printf("{\"file\": \"%s\", \"records\": %d, \"sent\": %d, \"transmitted\": %d, \"resent\": %d, \"received\": %d, \"touches\": %d, \"buttons\": %d, "
+           "\"recorded_ms\": %.1f, \"speed\": %.2f, \"replay_ms\": %.1f, \"replay_messages\": %d, \"replay_lost\": %d, "
+           "\"drawing_pending\": %d, \"frame_matches\": %s}\n",
+           file.getFullPathName().toRawUTF8(), replayer.getNumRecords(),
+           numRecords[TrafficRecord::sentMessage], numRecords[TrafficRecord::transmittedMessage], numRecords[TrafficRecord::resentMessage],
+           numRecords[TrafficRecord::receivedMessage], numRecords[TrafficRecord::touch], numRecords[TrafficRecord::button],
+           recordedTime, speed, replayTime, emulator.numReceived, emulator.numLost,
+           component.numDrawingMessages(), emulator.getDisplayedFrame()==reference.getDisplayedFrame() ? "true" : "false");
+    return 0;
+}
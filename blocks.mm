@@ -36,6 +36,7 @@ extern "C" void blocks_setup(void);
 static void blocks_setname(t_blocks *x, t_symbol *serial, t_symbol *name);
 static void blocks_command(t_blocks *x, t_symbol *s, int argc, t_atom *argv);
 static void blocks_bang(t_blocks *x);
+static void blocks_stats(t_blocks *x, t_symbol *s, int argc, t_atom *argv);
 
 static void *blocks_new(t_symbol *s, int argc, t_atom *argv)
 {
@@ -76,6 +77,7 @@ extern "C" void blocks_setup(void)
         (t_method)blocks_free, sizeof(t_blocks), CLASS_DEFAULT, A_GIMME, A_NULL);
     
     class_addmethod(blocks_class, (t_method)blocks_setname, gensym("setname"), A_DEFSYMBOL, A_DEFSYMBOL, 0);
+    class_addmethod(blocks_class, (t_method)blocks_stats, gensym("stats"), A_GIMME, 0);
     class_addanything(blocks_class, (t_method)blocks_command);
     class_addbang(blocks_class, (t_method)blocks_bang);
 }
@@ -111,3 +113,13 @@ static void blocks_bang(t_blocks *x) {
         x->juceThread->mBlockFinder->pollInfos();
     }
 }
+
+static void blocks_stats(t_blocks *x, t_symbol *s, int argc, t_atom *argv) {
+    // also without arguments
+    while (!x->juceThread->blockReady) {
+        juce::Thread::getCurrentThread()->sleep(10);
+    }
+    if (x->juceThread->mBlockFinder!=nullptr) {
+        x->juceThread->mBlockFinder->doBlockCommand(s, argc, argv);
+    }
+}